@@ -1,12 +1,32 @@
 // Author: Justin Tromp
 // Date: 04/25/2020
 // Description: Adventure allows a user to navigate from a starting room in the newest directory of rooms
-// to an end room through command line input. With use of threading, user can input "time" instead of room
-// in order to output current time to a file, which is then read into the main program and outputted to
-// the terminal screen. After a win condition is reached, user gets a congratulatory message and is informed
-// of the number of rooms moved through, as well as the rooms that were moved through by name.
+// to an end room through command line input. User can input "time" instead of room to have a long lived time
+// worker thread hand the current time to the main program, which outputs it to the terminal screen, or "hint" to be
+// told which connection leads towards the end room, looked up in the world's shortest path tables. The time is
+// handed over in memory by default, through a pipe with --time-transport pipe, or through a file with
+// --time-transport file or --time-file PATH (currentTime.txt unless a path is given). After a win condition is
+// reached, user gets a congratulatory message and is informed of the number of rooms moved through, as well as the
+// rooms that were moved through by name. The newest world can be a packed world file (see trompj.world.h) or a
+// directory of text room files. Packed worlds played on the terminal are paged: rooms are read from the file as the
+// player reaches them and at most --room-cache N of them (4096 by default) are kept in memory, so the game starts as
+// fast on a million room world as on seven rooms. With --serve PATH, adventure loads the world once and serves any
+// number of players over a UNIX domain socket at PATH instead of the terminal, running their commands on --workers N
+// threads (all online cores by default). --solve outputs a shortest path from the start room to the end room of the
+// newest world instead of playing it, and --check-worlds LIST checks that every world listed in LIST, one per line, can
+// be solved, on --workers N threads. --batch plays a move script read from stdin, one command per line, and outputs
+// only a result record with the number of moves, invalid commands and games won; --batch-verbose also outputs the
+// transcript the game would show. Run with --bench-workers SESSIONS MOVES to time the worker pool with 1 to N
+// workers on the newest world, --bench-batch SESSIONS STEPS to time stepping a libadventure session batch on the newest
+// world, or --bench-scan N to time finding the newest world in a directory of N worlds with getdents64 against the
+// readdir and stat scan. Worlds are loaded and played through libadventure (see trompj.libadventure.h), so adventure is
+// built with:
+//   gcc -o adventure trompj.adventure.c trompj.libadventure.c -lpthread
 // REFERENCES: https://www.geeksforgeeks.org/mutex-lock-for-linux-thread-synchronization/
 
+// Needed for accept4
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <zconf.h>
@@ -15,43 +35,65 @@
 #include <time.h>
 #include <dirent.h>
 #include <pthread.h>
-
-// Struct for room name, room type, and an array of room connections.
-struct room {
-    char* roomName;
-    char* roomType;
-    char* roomConnections[6];
-};
-
-// Struct for use with thread to pass file pointer and mutex lock.
-struct fileThreadLock {
-    FILE* filePointer;
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <signal.h>
+#include <errno.h>
+#include "trompj.libadventure.h"
+
+// Ways the time worker thread hands the time to the main thread: a shared buffer, a pipe private to the process, or
+// a time file that is written and read back
+#define TIME_TRANSPORT_MEMORY 0
+#define TIME_TRANSPORT_PIPE 1
+#define TIME_TRANSPORT_FILE 2
+
+// Size of a time record, the time string with its terminator padded out. Records are written to the time pipe
+// whole, and being smaller than PIPE_BUF each write is atomic.
+#define TIME_RECORD_SIZE 80
+
+// Most lines of input run for a server session before it goes back on the queue behind other sessions
+#define SESSION_LINES_PER_RUN 64
+
+// Bytes of a move script read from stdin at once in batch mode, and of transcript held before it is written out
+#define BATCH_INPUT_SIZE (1024 * 1024)
+#define BATCH_OUTPUT_SIZE (64 * 1024)
+
+// Rooms whose location text a terminal game keeps rendered
+#define FRAME_CACHE_ROOMS 256
+
+// Struct for the time service shared by the main thread and the time worker thread. The main thread asks for the
+// time by bumping requestCount and the worker answers by bumping servedCount, both under lock. The time itself is
+// handed over by the transport: in timeString, as a record on the pipe, or in the time file at filePath. The
+// formatted string is cached until the minute changes.
+struct timeService {
+    pthread_t thread;
     pthread_mutex_t lock;
+    pthread_cond_t requested;
+    pthread_cond_t served;
+    int requestCount;
+    int servedCount;
+    int running;
+    int transport;
+    int pipeFds[2];
+    const char* filePath;
+    time_t cachedMinute;
+    char timeString[TIME_RECORD_SIZE];
 };
 
-// Opens or creates a new currentTime.txt file and outputs the current time to the file. Will overwrite
-// the file if it already exists. This is implemented as a thread with a mutex lock.
-// Pre-conditions: Must be passed a fileThreadLock struct pointer.
-// Post-conditions: Determines current time and outputs to currentTime.txt file.
-void* writeTimeFileThread(void* args) {
-    struct fileThreadLock* threadVars = args;
-
-    // Set mutex lock for thread
-    if (pthread_mutex_lock(&threadVars->lock) != 0) {
-        perror("Error locking mutex");
-        exit(1);
+// Formats the current time into timeString unless it already holds the time of the current minute.
+// Pre-conditions: Pass cached minute (-1 if nothing is cached) and its time string of TIME_RECORD_SIZE chars.
+// Post-conditions: Time string holds the current time. Returns 1 if it was formatted, 0 if the cache was current.
+int formatTime(time_t* cachedMinute, char timeString[]) {
+    // Set variables for use in time operations
+    time_t t = time(NULL);
+    if (t / 60 == *cachedMinute) {
+        return 0;
     }
 
-    char fileName[] = "currentTime.txt";
-    // Open and create file if necessary to write time to. Overwrite if exists.
-    threadVars->filePointer = fopen(fileName, "w");
-
-    // Set variables for use in time operations
-    char timeString[256];
-    time_t t;
-    struct tm* tmp;
-    t = time(NULL);
-    tmp = localtime(&t);
+    struct tm tmBuffer;
+    struct tm* tmp = localtime_r(&t, &tmBuffer);
 
     // If tmp is NULL, there was an error getting local time, exit and output error.
     if (tmp == NULL) {
@@ -60,468 +102,1905 @@ void* writeTimeFileThread(void* args) {
     }
 
     // Generate time/date string. If there is an error, output to stderr and exit
-    if (strftime(timeString, sizeof(timeString), "%l:%M%P, %A, %B %d, %Y\n", tmp) == 0) {
+    if (strftime(timeString, TIME_RECORD_SIZE, "%l:%M%P, %A, %B %d, %Y\n", tmp) == 0) {
         fprintf(stderr, "strftime error");
         exit(1);
     }
+    *cachedMinute = t / 60;
 
-    // Output time/date string to file
-    fprintf(threadVars->filePointer, "%s", timeString);
-    fflush(threadVars->filePointer);
+    return 1;
+}
 
-    // Close time file
-    fclose(threadVars->filePointer);
+// Formats the current time, reusing the cached string while the minute is unchanged. With the file transport each
+// new string is also outputted to the time file, overwriting the file if it already exists.
+// Pre-conditions: Must be passed a timeService struct pointer, with the lock held.
+// Post-conditions: Time string of the service holds the current time.
+void updateTimeString(struct timeService* service) {
+    if (formatTime(&service->cachedMinute, service->timeString) == 0 || service->transport != TIME_TRANSPORT_FILE) {
+        return;
+    }
 
-    // Unlock thread so time file can be accessed by main
-    if (pthread_mutex_unlock(&threadVars->lock) != 0) {
-        perror("Error unlocking mutex");
-        exit(1);
+    // Open and create file if necessary to write time to. Overwrite if exists.
+    FILE* filePointer = fopen(service->filePath, "w");
+    if (filePointer == NULL) {
+        perror("Error opening time file");
+        return;
     }
+
+    // Output time/date string to file and close it
+    fprintf(filePointer, "%s", service->timeString);
+    fclose(filePointer);
 }
 
-// Opens currentTime.txt file and reads the time from the file to be outputted to the terminal screen.
-// This is implemented as part of the main thread and utilizes the same mutex lock as file writing.
-// Pre-conditions: Must be passed a fileThreadLock struct pointer.
-// Post-conditions: Reads time from file sand outputs to terminal screen.
-void readTimeFile(struct fileThreadLock* threadVars) {
-    char fileName[] = "currentTime.txt";
-    // Open file to read time from
-    threadVars->filePointer = fopen(fileName, "r");
+// Long lived time worker thread. Waits for time requests from the main thread and answers each with the current
+// time string until the service is stopped.
+// Pre-conditions: Must be passed a timeService struct pointer.
+// Post-conditions: Every request made while running is served.
+void* timeWorkerThread(void* args) {
+    struct timeService* service = args;
 
-    char lineRead[80];
-    memset(lineRead, '\0', 80);
+    // Set mutex lock for thread, released while waiting for requests
+    if (pthread_mutex_lock(&service->lock) != 0) {
+        perror("Error locking mutex");
+        exit(1);
+    }
 
-    // Read first line from file and output to terminal
-    fseek(threadVars->filePointer, 0, SEEK_SET);
-    fgets(lineRead, 80, threadVars->filePointer);
-    printf("%s\n", lineRead);
+    while (1) {
+        // Wait until there is a request to serve or the service is stopped
+        while (service->servedCount == service->requestCount && service->running == 1) {
+            pthread_cond_wait(&service->requested, &service->lock);
+        }
+        if (service->servedCount == service->requestCount) {
+            break;
+        }
 
-    // Close time file
-    fclose(threadVars->filePointer);
+        updateTimeString(service);
+
+        // Pipe transport sends the time record to the main thread, blocked reading the pipe
+        if (service->transport == TIME_TRANSPORT_PIPE
+            && write(service->pipeFds[1], service->timeString, TIME_RECORD_SIZE) != TIME_RECORD_SIZE) {
+            perror("Error writing time pipe");
+            exit(1);
+        }
+
+        service->servedCount = service->requestCount;
+        pthread_cond_signal(&service->served);
+    }
+
+    pthread_mutex_unlock(&service->lock);
+
+    return NULL;
 }
 
-// Driver function for time processing, which directs the threading process and read/write of time file.
-// Pre-conditions: None
-// Post-conditions: Results in write of current time to currentTime.txt and output of time to terminal.
-void timeProcessing(struct fileThreadLock* threadVars) {
+// Starts the time service and its worker thread.
+// Pre-conditions: Pass time service struct pointer, time transport and path of time file for the file transport.
+// Post-conditions: Time worker thread is running and ready for requests.
+void startTimeService(struct timeService* service, int transport, const char* filePath) {
+    service->requestCount = 0;
+    service->servedCount = 0;
+    service->running = 1;
+    service->transport = transport;
+    service->filePath = filePath;
+    service->cachedMinute = -1;
+    memset(service->timeString, '\0', sizeof(service->timeString));
+
+    // Pipe is private to this process, so concurrent players never share it
+    if (transport == TIME_TRANSPORT_PIPE && pipe(service->pipeFds) != 0) {
+        perror("Error creating time pipe");
+        exit(1);
+    }
 
-    // Unlock mutex for thread to use
-    if (pthread_mutex_unlock(&threadVars->lock) != 0) {
-        perror("Error unlocking mutex");
+    // Initialize mutex and conditions and throw error if unable to initialize
+    if (pthread_mutex_init(&service->lock, NULL) != 0 || pthread_cond_init(&service->requested, NULL) != 0
+        || pthread_cond_init(&service->served, NULL) != 0) {
+        perror("Mutex initialization has failed!\n");
         exit(1);
     }
 
-    pthread_t thread;
-    // Create thread to write to file and throw error if unable to create
-    int error = pthread_create(&thread, NULL, &writeTimeFileThread, threadVars);
-    if (error != 0) {
+    // Create time worker thread and throw error if unable to create
+    if (pthread_create(&service->thread, NULL, &timeWorkerThread, service) != 0) {
         perror("Thread was unable to be created.");
         exit(1);
     }
+}
 
-    // Have main thread wait until completion of file write thread
-    pthread_join(thread, NULL);
+// Stops the time worker thread and releases the time service.
+// Pre-conditions: Pass started time service struct pointer.
+// Post-conditions: Time worker thread has exited and mutex and conditions are destroyed.
+void stopTimeService(struct timeService* service) {
+    pthread_mutex_lock(&service->lock);
+    service->running = 0;
+    pthread_cond_signal(&service->requested);
+    pthread_mutex_unlock(&service->lock);
+
+    pthread_join(service->thread, NULL);
+
+    pthread_cond_destroy(&service->requested);
+    pthread_cond_destroy(&service->served);
+    pthread_mutex_destroy(&service->lock);
+
+    if (service->transport == TIME_TRANSPORT_PIPE) {
+        close(service->pipeFds[0]);
+        close(service->pipeFds[1]);
+    }
+}
+
+// Opens the time file and reads the time from it.
+// Pre-conditions: Pass time service using the file transport and buffer of TIME_RECORD_SIZE chars.
+// Post-conditions: Time string read from file is in timeString, or it is empty if the file could not be read.
+void readTimeFile(struct timeService* service, char timeString[]) {
+    memset(timeString, '\0', TIME_RECORD_SIZE);
+
+    // Open file to read time from
+    FILE* filePointer = fopen(service->filePath, "r");
+    if (filePointer == NULL) {
+        perror("Error opening time file");
+        return;
+    }
+
+    // Read first line from file and close it
+    fgets(timeString, TIME_RECORD_SIZE, filePointer);
+    fclose(filePointer);
+}
 
+// Driver function for time processing, which requests the current time from the time worker thread and hands it back
+// for the game to output.
+// Pre-conditions: Pass started time service struct pointer and char array of TIME_RECORD_SIZE chars.
+// Post-conditions: Current time is in timeString.
+void timeProcessing(struct timeService* service, char timeString[]) {
     // Set mutex lock for main
-    if (pthread_mutex_lock(&threadVars->lock) != 0) {
+    if (pthread_mutex_lock(&service->lock) != 0) {
         perror("Error locking mutex");
         exit(1);
     }
 
-    // Read time from file and output to screen
-    readTimeFile(threadVars);
+    // Hand the request to the time worker
+    service->requestCount++;
+    pthread_cond_signal(&service->requested);
 
+    // Read the record off the pipe, which waits for the worker to send it
+    if (service->transport == TIME_TRANSPORT_PIPE) {
+        pthread_mutex_unlock(&service->lock);
+
+        if (read(service->pipeFds[0], timeString, TIME_RECORD_SIZE) != TIME_RECORD_SIZE) {
+            perror("Error reading time pipe");
+            exit(1);
+        }
+    }
+    // Otherwise wait until the request is served and take the time from memory or the time file
+    else {
+        while (service->servedCount != service->requestCount) {
+            pthread_cond_wait(&service->served, &service->lock);
+        }
+        if (service->transport == TIME_TRANSPORT_MEMORY) {
+            strcpy(timeString, service->timeString);
+        }
+
+        pthread_mutex_unlock(&service->lock);
+
+        if (service->transport == TIME_TRANSPORT_FILE) {
+            readTimeFile(service, timeString);
+        }
+    }
 }
 
-// Checks all directories in current location and determines the most recent rooms directory.
-// The name of the directory is saved in parameter variable for later use.
-// Pre-conditions: Char array parameter to save directory name to.
-// Post-conditions: Most recent directory name is saved to dirName char array.
-void mostRecentRooms(char dirName[128]) {
+// Finds the most recently modified world in a directory by reading every entry with readdir and calling stat on
+// every entry containing the world prefix. Kept as the baseline for the scan benchmark.
+// Pre-conditions: Pass path of directory and char array to save world name to.
+// Post-conditions: Newest world name is saved to dirName, or dirName is empty if there is none.
+void scanNewestWorldByStat(const char* path, char dirName[128]) {
     // Declare variables to be used in directory manipulation
     int newestModified = -1;
-    char dirPrefix[15] = "trompj.rooms.";
     memset(dirName, '\0', 128);
 
     // Starting directory
-    DIR* dirToExamine = opendir(".");
+    DIR* dirToExamine = opendir(path);
     // To hold sub directory of starting directory
     struct dirent* subDir;
     // To hold information about sub directory
     struct stat dirAttributes;
 
     // Check that directory could be opened
-    if (dirToExamine > 0) {
+    if (dirToExamine != NULL) {
         // Loop through directory contents
         while ((subDir = readdir(dirToExamine)) != NULL) {
 
-            // Check encountered entry for prefix
-            if (strstr(subDir->d_name, dirPrefix) != NULL) {
-
-                // Get attributes
-                stat(subDir->d_name, &dirAttributes);
+            // Check encountered entry for prefix and get attributes
+            if (strstr(subDir->d_name, WORLD_NAME_PREFIX) != NULL
+                && fstatat(dirfd(dirToExamine), subDir->d_name, &dirAttributes, 0) == 0) {
 
                 // Check if found subDir is newer than last newest directory
                 // If so, update time and name of directory
                 if ((int) dirAttributes.st_mtime > newestModified) {
                     newestModified = (int) dirAttributes.st_mtime;
 
-                    memset(dirName, '\0', 128);
-                    strcpy(dirName, subDir->d_name);
+                    snprintf(dirName, 128, "%.127s", subDir->d_name);
                 }
             }
         }
+
+        closedir(dirToExamine);
     }
     else {
         perror("Could not open directory");
     }
+}
 
-    closedir(dirToExamine);
+// Ends the game if its world could not read its file. Only paged worlds read rooms after loading, and their lookups
+// return error values once the file can't be read or holds an invalid room.
+// Pre-conditions: Pass loaded world.
+// Post-conditions: Returns if the world is readable, otherwise outputs the error and exits.
+void checkWorldRead(struct world* world) {
+    if (worldReadFailed(world) == 1) {
+        fprintf(stderr, "Error reading world file: it changed or has an invalid room\n");
+        exit(1);
+    }
 }
 
-// Takes a room struct pointer as parameter and sets all values to NULL to initialize.
-// Pre-conditions: Room struct pointer passed to be initialized.
-// Post-conditions: All aspects of the room struct are set to NULL.
-void initializeData(struct room* roomObj) {
-    // Initialize struct values before assignment
-    roomObj->roomName = NULL;
+// Returns the name of a room, ending the game if its world could not read it.
+// Pre-conditions: Pass loaded world and valid room id.
+// Post-conditions: Returns name of the room, valid as long as roomName's is.
+const char* gameRoomName(struct world* world, int roomId) {
+    const char* name = roomName(world, roomId);
+    if (name == NULL) {
+        checkWorldRead(world);
+    }
 
-    roomObj->roomType = NULL;
+    return name;
+}
 
-    unsigned int i = 0;
-    for(i; i < 6; i++){
-        roomObj->roomConnections[i] = NULL;
+// Formats the answer to a "hint" command: the connection to take towards the end room and how far away it is.
+// Both come from the world's routes, so a hint takes the same time no matter how large the world is.
+// Pre-conditions: Pass loaded world, id of the current room and buffer of at least 96 chars.
+// Post-conditions: Hint line, ending with a newline, is in hint.
+void formatHint(struct world* world, int roomId, char hint[]) {
+    int nextRoom = hintRoom(world, roomId);
+    int distance = distanceToEnd(world, roomId);
+    checkWorldRead(world);
+
+    if (nextRoom == -1) {
+        sprintf(hint, "HINT: THE END ROOM CANNOT BE REACHED FROM HERE.\n");
+    }
+    else {
+        sprintf(hint, "HINT: GO TO %s. THE END ROOM IS %d STEPS AWAY.\n", gameRoomName(world, nextRoom), distance);
     }
 }
 
-// Reads a room file and sets values in a room struct, such as name, type, and connections. This room
-// struct is then returned.
-// Pre-conditions: A FILE pointer is passed as parameter, which will be the file to read room information from.
-// Post-conditions: A room struct has all variables set with name, type, and connections for that room and is returned.
-struct room readFile(FILE* fPointer) {
-    char lineRead[256];
-    memset(lineRead, '\0', 256);
-
-    // Declare a room struct and initialize it to be returned at end of function with data
-    struct room roomObj;
-    initializeData(&roomObj);
-
-    int connNumber = 0;
-    // Read line from file
-    while (fgets(lineRead, 255, fPointer) != NULL) {
-        // Check if line is room name and add to struct
-        if (strstr(lineRead, "ROOM NAME:")) {
-            int roomIdx = 0;
-            int i = 11;
-            char* name = malloc(sizeof(char)*11);
-            memset(name, '\0', 11);
-            // Loop through result and extract data into struct
-            for (i; i < strlen(lineRead); i++) {
-                if (lineRead[i] != '\n') {
-                    name[roomIdx] = lineRead[i];
-                    roomIdx++;
-                }
+// Struct for the location text of a room held by a frame renderer, or a roomId of -1 for an empty slot. The text
+// buffer is kept when the slot is reused for another room and only grows.
+struct renderedRoom {
+    int roomId;
+    char* text;
+    size_t length;
+    size_t capacity;
+};
+
+// Struct for the output of a terminal game. Each turn's output is rendered into frame and written with a single
+// write. The location text of a room, its name and connections as the game shows them, is rendered the first time
+// the room is shown and copied from rooms after, a direct mapped cache of FRAME_CACHE_ROOMS slots indexed by room id.
+// A room rendered into an occupied slot replaces the room there, so memory is set by the slot count and the longest
+// location texts, not by the size of the world or the rooms visited.
+struct frameRenderer {
+    char* frame;
+    size_t frameLength;
+    size_t frameCapacity;
+    struct renderedRoom rooms[FRAME_CACHE_ROOMS];
+};
+
+// Appends bytes to a buffer, growing it geometrically.
+// Pre-conditions: Pass buffer with its length and capacity, and text with its length.
+// Post-conditions: Text is at the end of the buffer.
+void appendBuffer(char** buffer, size_t* bufferLength, size_t* bufferCapacity, const char* text, size_t length) {
+    if (*bufferLength + length > *bufferCapacity) {
+        size_t capacity = *bufferCapacity == 0 ? 512 : *bufferCapacity;
+        while (capacity < *bufferLength + length) {
+            capacity *= 2;
+        }
+
+        char* grown = realloc(*buffer, capacity);
+        if (grown == NULL) {
+            perror("Error allocating output");
+            exit(1);
+        }
+        *buffer = grown;
+        *bufferCapacity = capacity;
+    }
+
+    memcpy(&(*buffer)[*bufferLength], text, length);
+    *bufferLength += length;
+}
+
+// Initializes a frame renderer.
+// Pre-conditions: Pass frame renderer.
+// Post-conditions: Frame renderer is empty, with no rooms rendered.
+void initializeFrames(struct frameRenderer* frames) {
+    memset(frames, 0, sizeof(struct frameRenderer));
+
+    int slot;
+    for (slot = 0; slot < FRAME_CACHE_ROOMS; slot++) {
+        frames->rooms[slot].roomId = -1;
+    }
+}
+
+// Appends a string to the current frame.
+// Pre-conditions: Pass frame renderer and NUL terminated text.
+// Post-conditions: Text is at the end of the frame.
+void appendFrame(struct frameRenderer* frames, const char* text) {
+    appendBuffer(&frames->frame, &frames->frameLength, &frames->frameCapacity, text, strlen(text));
+}
+
+// Appends the current location and possible connections of a game to the current frame, rendering the room's text
+// into its slot unless the slot already holds it.
+// Pre-conditions: Pass frame renderer, its world and session.
+// Post-conditions: Location and connections are at the end of the frame.
+void appendLocationFrame(struct frameRenderer* frames, struct world* world, struct session* game) {
+    struct renderedRoom* rendered = &frames->rooms[game->currentRoom % FRAME_CACHE_ROOMS];
+
+    if (rendered->roomId != game->currentRoom) {
+        const uint32_t* connections;
+        int connectionCount = sessionNeighbors(game, &connections);
+        checkWorldRead(world);
+        const char* name = gameRoomName(world, game->currentRoom);
+
+        // Replace whatever room the slot held
+        rendered->roomId = -1;
+        rendered->length = 0;
+        appendBuffer(&rendered->text, &rendered->length, &rendered->capacity, "CURRENT LOCATION: ", 18);
+        appendBuffer(&rendered->text, &rendered->length, &rendered->capacity, name, strlen(name));
+        appendBuffer(&rendered->text, &rendered->length, &rendered->capacity, "\nPOSSIBLE CONNECTIONS:", 22);
+
+        int roomConnIdx;
+        for (roomConnIdx = 0; roomConnIdx < connectionCount; roomConnIdx++) {
+            name = gameRoomName(world, connections[roomConnIdx]);
+            appendBuffer(&rendered->text, &rendered->length, &rendered->capacity, " ", 1);
+            appendBuffer(&rendered->text, &rendered->length, &rendered->capacity, name, strlen(name));
+            appendBuffer(&rendered->text, &rendered->length, &rendered->capacity,
+                         roomConnIdx == connectionCount - 1 ? "." : ",", 1);
+        }
+        appendBuffer(&rendered->text, &rendered->length, &rendered->capacity, "\n", 1);
+
+        rendered->roomId = game->currentRoom;
+    }
+
+    appendBuffer(&frames->frame, &frames->frameLength, &frames->frameCapacity, rendered->text, rendered->length);
+}
+
+// Writes the current frame to standard output and starts an empty one.
+// Pre-conditions: Pass frame renderer.
+// Post-conditions: Frame is written, with one write unless the terminal takes it in parts.
+void writeFrame(struct frameRenderer* frames) {
+    size_t written = 0;
+
+    while (written < frames->frameLength) {
+        ssize_t result = write(STDOUT_FILENO, &frames->frame[written], frames->frameLength - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            perror("Error writing output");
+            exit(1);
+        }
+        written += (size_t) result;
+    }
+
+    frames->frameLength = 0;
+}
+
+// Frees the buffers of a frame renderer.
+// Pre-conditions: Pass initialized frame renderer.
+// Post-conditions: Frame and the text of every slot are freed.
+void freeFrames(struct frameRenderer* frames) {
+    free(frames->frame);
+
+    int slot;
+    for (slot = 0; slot < FRAME_CACHE_ROOMS; slot++) {
+        free(frames->rooms[slot].text);
+    }
+    memset(frames, 0, sizeof(struct frameRenderer));
+}
+
+// Runs game until user reaches an end room, after which the game driver will exit with all win conditions printed
+// for user to see. The game is a libadventure session, so moving to a connection is an array index. Typed room
+// names are resolved with the world's name index, so each command takes the same time no matter how large the world
+// is. Everything a turn outputs, the answer to the last command, the location and the prompt, is rendered into one
+// frame and written with a single write.
+// Pre-conditions: Must have valid world with room information filled, and the time transport with its time file.
+// Post-conditions: Driver function runs until the user reaches the end room or input ends. Win conditions are
+// outputted for user.
+void runGameDriver(struct world* world, int timeTransport, const char* timeFile) {
+
+    // Start at the starting location
+    struct session game;
+    initializeSession(&game, world);
+
+    struct frameRenderer frames;
+    initializeFrames(&frames);
+
+    char userInputRoom[WORLD_NAME_SIZE];
+    memset(userInputRoom, '\0', WORLD_NAME_SIZE);
+
+    // Start the time worker thread that serves "time" commands for the whole game
+    struct timeService timeService;
+    startTimeService(&timeService, timeTransport, timeFile);
+
+    // Frames bypass stdio, so send anything already printed ahead of them
+    fflush(stdout);
+
+    // First frame shows the starting location
+    appendLocationFrame(&frames, world, &game);
+    appendFrame(&frames, "WHERE TO? >");
+
+    int stepResult = STEP_MOVED;
+    // Loop until end room is reached and track number of steps and names of rooms visited
+    while (stepResult != STEP_END) {
+        // Output the turn and request user input
+        writeFrame(&frames);
+
+        char buffer[256];
+        memset(buffer, '\0', 256);
+        // Stop at the end of input, since no more commands can come
+        if (fgets(buffer, sizeof(buffer), stdin) == NULL) {
+            break;
+        }
+
+        // Get string without \n from user input for comparison, cut to the longest possible room name
+        memset(userInputRoom, '\0', WORLD_NAME_SIZE);
+        buffer[strcspn(buffer, "\n")] = '\0';
+        memcpy(userInputRoom, buffer, strnlen(buffer, WORLD_NAME_SIZE - 1));
+
+        // Move to the typed room if it is one of the connections, recording it in the path
+        stepResult = stepSession(&game, findRoomByName(world, userInputRoom));
+        checkWorldRead(world);
+
+        appendFrame(&frames, "\n");
+
+        // User requests time
+        if (stepResult == STEP_INVALID && strcmp(userInputRoom, "time") == 0) {
+            char timeString[TIME_RECORD_SIZE];
+            timeProcessing(&timeService, timeString);
+            appendFrame(&frames, timeString);
+            appendFrame(&frames, "\n");
+            appendFrame(&frames, "WHERE TO? >");
+            continue;
+        }
+        // User requests a hint towards the end room
+        else if (stepResult == STEP_INVALID && strcmp(userInputRoom, "hint") == 0) {
+            char hint[96];
+            formatHint(world, game.currentRoom, hint);
+            appendFrame(&frames, hint);
+            appendFrame(&frames, "\n");
+            appendFrame(&frames, "WHERE TO? >");
+            continue;
+        }
+        // If room was not found, output message indicating room not found
+        else if (stepResult == STEP_INVALID) {
+            appendFrame(&frames, "HUH? I DON’T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n");
+        }
+        // Check if room is END_ROOM and output win message/exit adventure if found
+        else if (stepResult == STEP_END) {
+            char stepLine[64];
+            sprintf(stepLine, "YOU TOOK %d STEPS. YOUR PATH TO VICTORY WAS:\n", game.path.count);
+            appendFrame(&frames, "YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");
+            appendFrame(&frames, stepLine);
+
+            int roomIdx;
+            // Loop through path and output rooms visited
+            for (roomIdx = 0; roomIdx < game.path.count; roomIdx++) {
+                appendFrame(&frames, gameRoomName(world, game.path.rooms[roomIdx]));
+                appendFrame(&frames, "\n");
             }
-            roomObj.roomName = name;
-
-        }
-        // Check if line is room type and add to struct
-        else if (strstr(lineRead, "ROOM TYPE:")) {
-            int roomIdx = 0;
-            int i = 11;
-            char* type = malloc(sizeof(char)*11);
-            memset(type, '\0', 11);
-            // Loop through result and extract data into struct
-            for (i; i < strlen(lineRead); i++) {
-                if (lineRead[i] != '\n') {
-                    type[roomIdx] = lineRead[i];
-                    roomIdx++;
-                }
+            writeFrame(&frames);
+            break;
+        }
+
+        appendLocationFrame(&frames, world, &game);
+        appendFrame(&frames, "WHERE TO? >");
+    }
+
+    // Free session and its visited rooms path, and the rendered frames
+    freeSession(&game);
+    freeFrames(&frames);
+
+    // Stop the time worker thread
+    stopTimeService(&timeService);
+}
+
+// Struct for a game played from a move script in batch mode: the session, what the script did so far, and the
+// transcript when it is asked for.
+struct batchGame {
+    struct world* world;
+    struct session game;
+    struct frameRenderer frames;
+    int verbose;
+    long moves;
+    long invalid;
+    long queries;
+    long games;
+    time_t cachedMinute;
+    char timeString[TIME_RECORD_SIZE];
+};
+
+// Runs one command of a move script the same way the game runs a line from the terminal, except that reaching the
+// end room starts a new game from the start room, as it does for server sessions. The transcript is only rendered in
+// verbose mode and is written out in blocks.
+// Pre-conditions: Pass batch game and NUL terminated line without its newline, which may be cut.
+// Post-conditions: Session has moved if the line names a connection and the counts of the batch game are updated.
+void runBatchCommand(struct batchGame* batch, char* line, size_t length) {
+    // Cut input to the longest possible room name
+    if (length >= WORLD_NAME_SIZE) {
+        line[WORLD_NAME_SIZE - 1] = '\0';
+    }
+
+    int stepResult = stepSession(&batch->game, findRoomByName(batch->world, line));
+
+    if (stepResult == STEP_MOVED) {
+        batch->moves++;
+        if (batch->verbose == 1) {
+            appendFrame(&batch->frames, "\n");
+        }
+    }
+    // Time and hint commands are answered without moving, so the location isn't shown again
+    else if (stepResult == STEP_INVALID && (strcmp(line, "time") == 0 || strcmp(line, "hint") == 0)) {
+        batch->queries++;
+        if (batch->verbose == 1) {
+            char hint[96];
+            if (line[0] == 't') {
+                formatTime(&batch->cachedMinute, batch->timeString);
             }
-            roomObj.roomType = type;
-        }
-        // Check if line is a connection and add to struct
-        else if (strstr(lineRead, "CONNECTION")) {
-            // Prepare string to accept a room connection name
-            char* roomConn = malloc(sizeof(char)*10);
-            memset(roomConn, '\0', 10);
-
-            int i = 14;
-            int strIdx = 0;
-            // Loop through result and extract data into struct
-            for (i; i < strlen(lineRead); i++) {
-                if (lineRead[i] != '\n') {
-                    roomConn[strIdx] = lineRead[i];
-                    strIdx++;
-                }
+            else {
+                formatHint(batch->world, batch->game.currentRoom, hint);
             }
-            // Set room connection
-            roomObj.roomConnections[connNumber] = roomConn;
-            connNumber++;
-        }
-        memset(lineRead, '\0', 256);
-    }
-
-    return roomObj;
-}
-
-// Open directory and read room file contents. Room information is saved to room struct objects and set
-// to an array of room structs for later use.
-// Pre-conditions: Valid name of directory (dirName) and array of room structs to set values to.
-// Post-conditions: Array of room structs has values set for later use in program.
-void setRoomArray(char dirName[], struct room roomArr[]) {
-
-    // Open directory
-    DIR *dirToOpen;
-    dirToOpen = opendir(dirName);
-    struct dirent *fileInDir;
-
-    // Check if directory could be opened, if not output error
-    if (dirToOpen > 0) {
-        int arrIdx = 0;
-        // Loop through contents (room files)
-        while ((fileInDir = readdir(dirToOpen)) != NULL) {
-            // If _room file is found, open it and extract data
-            if (strstr(fileInDir->d_name, "_room")) {
-                char pathName[256];
-                memset(pathName, '\0', 256);
-
-                // Create path of file and open it
-                strcat(pathName, dirName);
-                strcat(pathName, "/");
-                strcat(pathName, fileInDir->d_name);
-
-                FILE *fPointer = fopen(pathName, "r");
-                // Check to see if file was opened
-                if (fPointer == NULL) {
-                    perror("Error opening a file.");
-                }
-                    // Output room name and room type to struct
-                else {
-                    // Set values in structs from files
-                    roomArr[arrIdx] = readFile(fPointer);
-                    arrIdx++;
-                }
-
-                fclose(fPointer);
+            appendFrame(&batch->frames, "\n");
+            appendFrame(&batch->frames, line[0] == 't' ? batch->timeString : hint);
+            appendFrame(&batch->frames, "\nWHERE TO? >");
+        }
+        return;
+    }
+    else if (stepResult == STEP_INVALID) {
+        batch->invalid++;
+        if (batch->verbose == 1) {
+            appendFrame(&batch->frames, "\nHUH? I DON’T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n");
+        }
+    }
+    // Count the win and start a new game
+    else {
+        batch->moves++;
+        batch->games++;
+        if (batch->verbose == 1) {
+            char stepLine[64];
+            sprintf(stepLine, "YOU TOOK %d STEPS. YOUR PATH TO VICTORY WAS:\n", batch->game.path.count);
+            appendFrame(&batch->frames, "\nYOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");
+            appendFrame(&batch->frames, stepLine);
+
+            int roomIdx;
+            for (roomIdx = 0; roomIdx < batch->game.path.count; roomIdx++) {
+                appendFrame(&batch->frames, roomName(batch->world, batch->game.path.rooms[roomIdx]));
+                appendFrame(&batch->frames, "\n");
             }
+            appendFrame(&batch->frames, "\n");
         }
 
-        // Close the directory used to access room files
-        closedir(dirToOpen);
+        resetSession(&batch->game);
     }
-        // Directory opening issue, output error
-    else {
-        perror("Directory could not be opened");
+
+    if (batch->verbose == 1) {
+        appendLocationFrame(&batch->frames, batch->world, &batch->game);
+        appendFrame(&batch->frames, "WHERE TO? >");
+        if (batch->frames.frameLength >= BATCH_OUTPUT_SIZE) {
+            writeFrame(&batch->frames);
+        }
+    }
+}
+
+// Plays a move script from stdin, one command per line, as fast as it can be read. Input is read in blocks of
+// BATCH_INPUT_SIZE bytes and split into lines in place, so commands are never copied. Only a result record is
+// outputted: the number of moves, invalid commands, time and hint queries and games won, and where the game in
+// progress is. With verbose, the transcript the game would show comes before it.
+// Pre-conditions: Pass loaded world and 1 to output the transcript, otherwise 0.
+// Post-conditions: Script is played to the end of stdin and the result record is outputted. Returns 1 on success,
+// otherwise 0 with the error reported.
+int runBatch(struct world* world, int verbose) {
+    struct batchGame batch;
+    memset(&batch, 0, sizeof(struct batchGame));
+    batch.world = world;
+    batch.verbose = verbose;
+    batch.cachedMinute = -1;
+    initializeSession(&batch.game, world);
+    initializeFrames(&batch.frames);
+
+    // One spare byte ends a line cut by the end of the buffer
+    char* input = malloc(BATCH_INPUT_SIZE + 1);
+    if (input == NULL) {
+        perror("Error allocating input");
+        exit(1);
+    }
+
+    // Frames bypass stdio, so send anything already printed ahead of them
+    fflush(stdout);
+
+    if (verbose == 1) {
+        appendLocationFrame(&batch.frames, world, &batch.game);
+        appendFrame(&batch.frames, "WHERE TO? >");
+    }
+
+    int success = 1;
+    size_t length = 0;
+    for (;;) {
+        ssize_t got = read(STDIN_FILENO, &input[length], BATCH_INPUT_SIZE - length);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            perror("Error reading move script");
+            success = 0;
+            break;
+        }
+        length += (size_t) got;
+
+        // Run every complete line in the buffer
+        size_t lineStart = 0;
+        char* newline;
+        while ((newline = memchr(&input[lineStart], '\n', length - lineStart)) != NULL) {
+            *newline = '\0';
+            runBatchCommand(&batch, &input[lineStart], (size_t) (newline - &input[lineStart]));
+            lineStart = (size_t) (newline - input) + 1;
+        }
+
+        // The end of input ends the last line, as does a full buffer without a newline, like a cut terminal line
+        if ((got == 0 || (lineStart == 0 && length == BATCH_INPUT_SIZE)) && lineStart < length) {
+            input[length] = '\0';
+            runBatchCommand(&batch, &input[lineStart], length - lineStart);
+            lineStart = length;
+        }
+
+        // Keep a partial line for the next block
+        memmove(input, &input[lineStart], length - lineStart);
+        length -= lineStart;
+
+        if (got == 0) {
+            break;
+        }
     }
 
+    // Output the result record after the transcript
+    char record[WORLD_NAME_SIZE + 160];
+    sprintf(record, "%sRESULT moves=%ld invalid=%ld queries=%ld games=%ld steps=%d room=%s\n",
+            verbose == 1 ? "\n" : "", batch.moves, batch.invalid, batch.queries, batch.games,
+            batch.game.path.count, roomName(world, batch.game.currentRoom));
+    appendFrame(&batch.frames, record);
+    writeFrame(&batch.frames);
+
+    free(input);
+    freeSession(&batch.game);
+    freeFrames(&batch.frames);
+
+    return success;
 }
 
-// Runs game until user reaches an end room, after which the game driver will exit with all win conditions printed
-// for user to see.
-// Pre-conditions: Must have valid room struct array with room information filled.
-// Post-conditions: Driver function runs until the user reaches the end room. Win conditions are outputted for user.
-runGameDriver(struct room roomArr[]) {
-
-    struct room* currentRoom;
-    int roomNum = 0;
-    // Find starting location and set current rom pointer to starting room
-    for (roomNum; roomNum < 7; roomNum++) {
-        if (strcmp(roomArr[roomNum].roomType, "START_ROOM") == 0) {
-            currentRoom = &roomArr[roomNum];
-        }
-    }
-
-    int stepCount = 0;
-    char userInputRoom[10];
-    memset(userInputRoom, '\0', 10);
-    char **visitedRooms = NULL;
-
-    // Set thread struct in thread struct pointer for use throughout program for time processing.
-    // Allows threads to be managed by same mutex lock and pass file pointers as needed.
-    struct fileThreadLock* threadVars;
-    struct fileThreadLock threadInfo;
-    threadVars = &threadInfo;
-    // Initialize mutex and throw error if unable to initialize
-    if (pthread_mutex_init(&threadInfo.lock, NULL) != 0) {
-        perror("Mutex initialization has failed!\n");
+// Struct for a player session of the game server: the player's socket, game, input not yet handled, and output the
+// socket has not accepted yet. A session is only ever held by one worker thread at a time,
+// so none of its fields need a lock. Benchmark sessions have no socket and read their input from script instead.
+struct serverSession {
+    int fd;
+    int sessionIdx;
+    int homeWorker;
+    int closing;
+    struct session game;
+    int inputStart;
+    int inputLength;
+    char input[256];
+    char* output;
+    size_t outputLength;
+    size_t outputSent;
+    size_t outputCapacity;
+    const char* script;
+    size_t scriptLength;
+    size_t scriptPos;
+};
 
-        exit(1);
+// Struct for a worker's queue of sessions with commands to run. The owning worker takes sessions from the head and
+// idle workers steal from the tail. Each queue has its own lock, so workers only contend when stealing.
+struct sessionQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    struct serverSession** sessions;
+    int head;
+    int count;
+    int capacity;
+    int sleeping;
+};
+
+// Struct for a worker thread of the game server, with its queue and its own cached time string.
+struct serverWorker {
+    struct gameServer* server;
+    int workerIdx;
+    pthread_t thread;
+    struct sessionQueue queue;
+    time_t cachedMinute;
+    char timeString[TIME_RECORD_SIZE];
+};
+
+// Struct for the game server: the shared read only world, the epoll instance and listening socket, the worker
+// pool, and every connected session. The session list lock is only taken to add and remove sessions.
+struct gameServer {
+    struct world* world;
+    int epollFd;
+    int listenFd;
+    struct serverWorker* workers;
+    int workerCount;
+    int nextWorker;
+    int workersRunning;
+    int finishedScripts;
+    pthread_mutex_t sessionsLock;
+    struct serverSession** sessions;
+    int sessionCount;
+    int sessionCapacity;
+};
+
+// Set by the signal handler to stop the game server
+static volatile sig_atomic_t serverRunning = 1;
+
+// Signal handler that stops the game server after the current batch of events.
+// Pre-conditions: Installed for SIGINT and SIGTERM.
+// Post-conditions: Server loop exits.
+void stopServer(int signalNum) {
+    (void) signalNum;
+    serverRunning = 0;
+}
+
+// Appends text to a session's pending output, growing the buffer geometrically.
+// Pre-conditions: Pass session, text and its length.
+// Post-conditions: Text is at the end of the session's pending output.
+void appendOutput(struct serverSession* session, const char* text, size_t length) {
+    appendBuffer(&session->output, &session->outputLength, &session->outputCapacity, text, length);
+}
+
+// Appends a string to a session's pending output.
+// Pre-conditions: Pass session and NUL terminated text.
+// Post-conditions: Text is at the end of the session's pending output.
+void appendString(struct serverSession* session, const char* text) {
+    appendOutput(session, text, strlen(text));
+}
+
+// Appends the current location and possible connections of a session, in the same form as the game outputs them.
+// Pre-conditions: Pass world and session.
+// Post-conditions: Location and connections are at the end of the session's pending output.
+void appendLocation(struct world* world, struct serverSession* session) {
+    const uint32_t* connections;
+    int connectionCount = sessionNeighbors(&session->game, &connections);
+
+    appendString(session, "CURRENT LOCATION: ");
+    appendString(session, roomName(world, session->game.currentRoom));
+    appendString(session, "\nPOSSIBLE CONNECTIONS:");
+
+    int roomConnIdx;
+    for (roomConnIdx = 0; roomConnIdx < connectionCount; roomConnIdx++) {
+        appendString(session, " ");
+        appendString(session, roomName(world, connections[roomConnIdx]));
+        appendString(session, roomConnIdx == connectionCount - 1 ? "." : ",");
+    }
+    appendString(session, "\n");
+}
+
+// Handles one line of input from a session the same way the game handles a line from the terminal. Reaching the
+// end room starts a new game from the start room, so a connection can play any number of games.
+// Pre-conditions: Pass worker running the session, session and NUL terminated line without its newline.
+// Post-conditions: Session has moved if the line names a connection, and its response is in pending output.
+void handleSessionLine(struct serverWorker* worker, struct serverSession* session, const char* line) {
+    struct world* world = worker->server->world;
+
+    // Cut input to the longest possible room name
+    char userInputRoom[WORLD_NAME_SIZE];
+    memset(userInputRoom, '\0', WORLD_NAME_SIZE);
+    memcpy(userInputRoom, line, strnlen(line, WORLD_NAME_SIZE - 1));
+
+    // Move to the typed room if it is one of the connections
+    int stepResult = stepSession(&session->game, findRoomByName(world, userInputRoom));
+
+    appendString(session, "\n");
+
+    // User requests time, which only needs formatting once a minute
+    if (stepResult == STEP_INVALID && strcmp(userInputRoom, "time") == 0) {
+        formatTime(&worker->cachedMinute, worker->timeString);
+        appendString(session, worker->timeString);
+        appendString(session, "\n");
+        appendString(session, "WHERE TO? >");
+        return;
+    }
+    // User requests a hint, answered from the world's routes
+    else if (stepResult == STEP_INVALID && strcmp(userInputRoom, "hint") == 0) {
+        char hint[96];
+        formatHint(world, session->game.currentRoom, hint);
+        appendString(session, hint);
+        appendString(session, "\n");
+        appendString(session, "WHERE TO? >");
+        return;
+    }
+    else if (stepResult == STEP_INVALID) {
+        appendString(session, "HUH? I DON’T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n");
     }
+    // Output win message and start a new game
+    else if (stepResult == STEP_END) {
+        char stepLine[64];
+        sprintf(stepLine, "YOU TOOK %d STEPS. YOUR PATH TO VICTORY WAS:\n", session->game.path.count);
+        appendString(session, "YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");
+        appendString(session, stepLine);
+
+        int roomIdx;
+        for (roomIdx = 0; roomIdx < session->game.path.count; roomIdx++) {
+            appendString(session, roomName(world, session->game.path.rooms[roomIdx]));
+            appendString(session, "\n");
+        }
+        appendString(session, "\n");
 
-    // Set mutex lock for main
-    if (pthread_mutex_lock(&threadVars->lock) != 0) {
-        perror("Error locking mutex");
+        resetSession(&session->game);
+    }
+
+    appendLocation(world, session);
+    appendString(session, "WHERE TO? >");
+}
+
+// Creates a session at the start room and adds it to the server's session list.
+// Pre-conditions: Pass server and socket of session, or -1 for a benchmark session.
+// Post-conditions: Returns new session, assigned to the next worker in turn.
+struct serverSession* createSession(struct gameServer* server, int fd) {
+    struct serverSession* session = calloc(1, sizeof(struct serverSession));
+    if (session == NULL) {
+        perror("Error allocating session");
         exit(1);
     }
+    session->fd = fd;
+    initializeSession(&session->game, server->world);
+
+    pthread_mutex_lock(&server->sessionsLock);
+
+    // Make room for another session
+    if (server->sessionCount == server->sessionCapacity) {
+        server->sessionCapacity = server->sessionCapacity == 0 ? 64 : server->sessionCapacity * 2;
+        server->sessions = realloc(server->sessions, sizeof(struct serverSession*) * server->sessionCapacity);
+        if (server->sessions == NULL) {
+            perror("Error allocating sessions");
+            exit(1);
+        }
+    }
+    session->sessionIdx = server->sessionCount;
+    server->sessions[server->sessionCount] = session;
+    server->sessionCount++;
 
-    // Loop until end room is reached and track number of steps and names of rooms visited
-    while (strcmp(currentRoom->roomType, "END_ROOM") != 0) {
-
-        if (strcmp(userInputRoom, "time") != 0) {
-            // Output current location name
-            printf("CURRENT LOCATION: %s\n", currentRoom->roomName);
-
-            // Output possible connections from current location
-            printf("POSSIBLE CONNECTIONS:");
-            int roomConnIdx = 0;
-            for (roomConnIdx;
-                 roomConnIdx < sizeof(currentRoom->roomConnections) / sizeof(*currentRoom->roomConnections);
-                 roomConnIdx++) {
-                // Check if room name encountered is null, if so then exit loop
-                if (currentRoom->roomConnections[roomConnIdx] == NULL) {
-                    break;
-                }
+    // Spread sessions over the workers' queues
+    session->homeWorker = server->nextWorker;
+    server->nextWorker = (server->nextWorker + 1) % server->workerCount;
 
-                // Output room name to terminal
-                printf(" %s", currentRoom->roomConnections[roomConnIdx]);
+    pthread_mutex_unlock(&server->sessionsLock);
 
-                // Output expected punctuation based on whether next room connection is NULL or not
-                if (roomConnIdx == 5) {
-                    printf(".");
-                }
-                else if (currentRoom->roomConnections[roomConnIdx+1] != NULL) {
-                    printf(",");
-                }
-                else {
-                    printf(".");
-                }
-            }
-            printf("\n");
+    return session;
+}
+
+// Closes a session's socket and frees it, moving the last session into its place.
+// Pre-conditions: Pass server and session not held by any other thread.
+// Post-conditions: Session is closed and freed.
+void closeSession(struct gameServer* server, struct serverSession* session) {
+    // Closing the socket also removes it from the epoll instance
+    if (session->fd != -1) {
+        close(session->fd);
+    }
+
+    pthread_mutex_lock(&server->sessionsLock);
+    server->sessionCount--;
+    struct serverSession* last = server->sessions[server->sessionCount];
+    server->sessions[session->sessionIdx] = last;
+    last->sessionIdx = session->sessionIdx;
+    pthread_mutex_unlock(&server->sessionsLock);
+
+    freeSession(&session->game);
+    free(session->output);
+    free(session);
+}
+
+// Wakes a sleeping worker so it can take work from its own queue or steal from others.
+// Pre-conditions: Pass worker.
+// Post-conditions: Worker is running if it was asleep.
+void wakeWorker(struct serverWorker* worker) {
+    if (__atomic_load_n(&worker->queue.sleeping, __ATOMIC_SEQ_CST) == 1) {
+        pthread_mutex_lock(&worker->queue.lock);
+        pthread_cond_signal(&worker->queue.ready);
+        pthread_mutex_unlock(&worker->queue.lock);
+    }
+}
+
+// Adds a session to the tail of a worker's queue, waking the worker if it is asleep. When the queue already holds
+// other work, a sleeping peer is woken too so it can steal some of it.
+// Pre-conditions: Pass server, worker and session held by the caller.
+// Post-conditions: Session is queued and no longer held by the caller.
+void scheduleSession(struct gameServer* server, struct serverWorker* worker, struct serverSession* session) {
+    struct sessionQueue* queue = &worker->queue;
+
+    pthread_mutex_lock(&queue->lock);
+
+    // Grow ring buffer, unwrapping it into the new space
+    if (queue->count == queue->capacity) {
+        int capacity = queue->capacity == 0 ? 64 : queue->capacity * 2;
+        struct serverSession** sessions = malloc(sizeof(struct serverSession*) * capacity);
+        if (sessions == NULL) {
+            perror("Error allocating session queue");
+            exit(1);
         }
 
-        char buffer[256];
-        memset(buffer, '\0', 256);
-        // Request and accept user input
-        printf("WHERE TO? >");
-        fgets(buffer, sizeof(buffer), stdin);
-
-        // Get string without \n from user input for comparison
-        memset(userInputRoom, '\0', 10);
-        strcpy(userInputRoom, buffer);
-        userInputRoom[(strlen(userInputRoom)-1)] = '\0';
-
-        int roomConnIdx = 0;
-        int roomFound = 0;
-        // Loop through possible room connections to check against user input for match
-        for (roomConnIdx; roomConnIdx < sizeof(currentRoom->roomConnections)/sizeof(*currentRoom->roomConnections);
-             roomConnIdx++) {
-            // Check if room name encountered is null, if so then exit loop
-            if (currentRoom->roomConnections[roomConnIdx] == NULL) {
+        int queueIdx;
+        for (queueIdx = 0; queueIdx < queue->count; queueIdx++) {
+            sessions[queueIdx] = queue->sessions[(queue->head + queueIdx) % queue->capacity];
+        }
+        free(queue->sessions);
+        queue->sessions = sessions;
+        queue->head = 0;
+        queue->capacity = capacity;
+    }
+
+    queue->sessions[(queue->head + queue->count) % queue->capacity] = session;
+    __atomic_store_n(&queue->count, queue->count + 1, __ATOMIC_SEQ_CST);
+    int backlog = queue->count;
+    if (queue->sleeping == 1) {
+        pthread_cond_signal(&queue->ready);
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+
+    // Let an idle peer help with the backlog
+    if (backlog > 1) {
+        int peer;
+        for (peer = 1; peer < server->workerCount; peer++) {
+            struct serverWorker* other = &server->workers[(worker->workerIdx + peer) % server->workerCount];
+            if (__atomic_load_n(&other->queue.sleeping, __ATOMIC_SEQ_CST) == 1) {
+                wakeWorker(other);
                 break;
             }
+        }
+    }
+}
 
-            // Check if room matches a connection and break/change current room to new room connection if so
-            if (strcmp(currentRoom->roomConnections[roomConnIdx], userInputRoom) == 0) {
-                int roomNum = 0;
-                // Find matching room from array and set currentRoom as new room moved to
-                for (roomNum; roomNum < 7; roomNum++) {
-                    if (strcmp(roomArr[roomNum].roomName, userInputRoom) == 0) {
-                        currentRoom = &roomArr[roomNum];
-                        roomFound = 1;
-
-                        stepCount++;
-                        char** newVisitedRooms = malloc(stepCount * sizeof(char*));
-                        int i = 0;
-                        // Loop through array and add
-                        for (i; i < stepCount; i++) {
-                            newVisitedRooms[i] = malloc(sizeof(char)*10);
-                        }
-
-                        i = 0;
-                        // Loop through and copy values to new dynamically allocated array. Free memory after copy.
-                        for (i; i < (stepCount-1); i++) {
-                            free(newVisitedRooms[i]);
-                            newVisitedRooms[i] = visitedRooms[i];
-                        }
-                        free(visitedRooms);
-
-                        // Add newly visted room to visited rooms array
-                        strcpy(newVisitedRooms[(stepCount-1)], userInputRoom);
-                        visitedRooms = newVisitedRooms;
-                        newVisitedRooms = NULL;
-                    }
-                }
+// Takes a session from a queue, from the head for the owning worker or from the tail when stealing.
+// Pre-conditions: Pass queue and whether the caller is stealing.
+// Post-conditions: Returns session now held by the caller, or NULL if the queue is empty.
+struct serverSession* takeSession(struct sessionQueue* queue, int stealing) {
+    if (__atomic_load_n(&queue->count, __ATOMIC_SEQ_CST) == 0) {
+        return NULL;
+    }
 
-                break;
+    pthread_mutex_lock(&queue->lock);
+    struct serverSession* session = NULL;
+    if (queue->count > 0) {
+        if (stealing == 1) {
+            session = queue->sessions[(queue->head + queue->count - 1) % queue->capacity];
+        }
+        else {
+            session = queue->sessions[queue->head];
+            queue->head = (queue->head + 1) % queue->capacity;
+        }
+        __atomic_store_n(&queue->count, queue->count - 1, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return session;
+}
+
+// Reads more input for a session from its socket, or from its script for benchmark sessions.
+// Pre-conditions: Pass session and buffer space to read into.
+// Post-conditions: Returns bytes read, 0 at end of input, or -1 with errno set.
+ssize_t readSessionInput(struct serverSession* session, char* buffer, size_t length) {
+    if (session->fd != -1) {
+        return read(session->fd, buffer, length);
+    }
+
+    size_t remaining = session->scriptLength - session->scriptPos;
+    if (length > remaining) {
+        length = remaining;
+    }
+    memcpy(buffer, &session->script[session->scriptPos], length);
+    session->scriptPos += length;
+
+    return (ssize_t) length;
+}
+
+// Sends as much of a session's pending output as its socket accepts. Benchmark sessions discard their output.
+// Pre-conditions: Pass held session.
+// Post-conditions: Accepted output is removed from pending output. Session is marked closing on socket errors.
+void flushSession(struct serverSession* session) {
+    while (session->fd != -1 && session->outputSent < session->outputLength) {
+        ssize_t sent = send(session->fd, &session->output[session->outputSent],
+                            session->outputLength - session->outputSent, MSG_NOSIGNAL);
+        if (sent > 0) {
+            session->outputSent += (size_t) sent;
+        }
+        else if (sent == -1 && errno == EINTR) {
+            continue;
+        }
+        else if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        else {
+            session->closing = 1;
+            return;
+        }
+    }
+
+    session->outputSent = 0;
+    session->outputLength = 0;
+}
+
+// Rearms a session's socket with the epoll instance. Sessions are registered one shot, so the socket reports
+// nothing while a worker holds the session. While output is pending the session waits for the socket to become
+// writable instead of reading more input, so a slow reader cannot grow its output without bound.
+// Pre-conditions: Pass server and held session with a socket.
+// Post-conditions: Session is no longer held and is queued again by the epoll loop on its next event.
+void rearmSession(struct gameServer* server, struct serverSession* session) {
+    struct epoll_event event;
+    event.data.ptr = session;
+    event.events = EPOLLONESHOT | (session->outputLength > 0 ? EPOLLOUT : EPOLLIN | EPOLLRDHUP);
+    epoll_ctl(server->epollFd, EPOLL_CTL_MOD, session->fd, &event);
+}
+
+// Runs queued commands of a session: handles up to SESSION_LINES_PER_RUN lines of input, reading more as needed,
+// and sends the responses. A session with more input after that goes back on its home worker's queue behind other
+// sessions, so a busy session cannot hold a worker to itself, idle workers can steal it, and a stolen session
+// returns to its home core.
+// Pre-conditions: Pass worker and session it holds.
+// Post-conditions: Session is rearmed, queued again, finished or closed.
+void runSession(struct serverWorker* worker, struct serverSession* session) {
+    struct gameServer* server = worker->server;
+    int linesHandled = 0;
+    int endOfInput = 0;
+
+    // Output from the last run must be accepted before more commands are run
+    flushSession(session);
+    if (session->outputLength > 0 && session->closing == 0) {
+        rearmSession(server, session);
+        return;
+    }
+
+    while (session->closing == 0 && linesHandled < SESSION_LINES_PER_RUN) {
+        char* lineStart = &session->input[session->inputStart];
+        char* newline = memchr(lineStart, '\n', (size_t) (session->inputLength - session->inputStart));
+
+        // Handle the next complete line, or a line that fills the whole buffer
+        if (newline != NULL || (session->inputStart == 0 && session->inputLength == (int) sizeof(session->input) - 1)) {
+            if (newline == NULL) {
+                newline = &session->input[session->inputLength];
+            }
+            *newline = '\0';
+            handleSessionLine(worker, session, lineStart);
+            session->inputStart = (int) (newline - session->input) + 1;
+            if (session->inputStart > session->inputLength) {
+                session->inputStart = session->inputLength;
             }
+            linesHandled++;
+            continue;
         }
 
-        printf("\n");
+        // Move the unterminated rest of the input to the front and read more
+        session->inputLength -= session->inputStart;
+        memmove(session->input, lineStart, (size_t) session->inputLength);
+        session->inputStart = 0;
 
-        // User requests time
-        if (roomFound == 0 && strcmp(userInputRoom, "time") == 0) {
-            timeProcessing(threadVars);
+        ssize_t received = readSessionInput(session, &session->input[session->inputLength],
+                                            sizeof(session->input) - 1 - session->inputLength);
+        if (received > 0) {
+            session->inputLength += (int) received;
         }
-        // If room was not found, output message indicating room not found
-        else if (roomFound == 0) {
-            printf("HUH? I DON’T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n");
+        else if (received == -1 && errno == EINTR) {
+            continue;
         }
-        // Check if room is END_ROOM and output win message/exit adventure if found
-        else if (strcmp(currentRoom->roomType, "END_ROOM") == 0) {
-            printf("YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");
-            printf("YOU TOOK %d STEPS. YOUR PATH TO VICTORY WAS:\n", stepCount);
+        else if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        else {
+            endOfInput = 1;
+            break;
+        }
+    }
 
-            int roomIdx = 0;
-            // Loop through path and output rooms visited
-            for (roomIdx; roomIdx < stepCount; roomIdx++) {
-                printf("%s\n", visitedRooms[roomIdx]);
+    flushSession(session);
+
+    // Benchmark sessions are done once their script is used up
+    if (session->fd == -1 && endOfInput == 1) {
+        __atomic_fetch_add(&server->finishedScripts, 1, __ATOMIC_SEQ_CST);
+    }
+    else if (session->closing == 1 || endOfInput == 1) {
+        closeSession(server, session);
+    }
+    else if (linesHandled == SESSION_LINES_PER_RUN && session->outputLength == 0) {
+        scheduleSession(server, &server->workers[session->homeWorker], session);
+    }
+    else {
+        rearmSession(server, session);
+    }
+}
+
+// Worker thread of the game server. Runs sessions from its own queue, steals from other workers' queues when its
+// own is empty, and sleeps when there is no work anywhere.
+// Pre-conditions: Must be passed a serverWorker struct pointer.
+// Post-conditions: Runs until the server stops its workers.
+void* serverWorkerThread(void* args) {
+    struct serverWorker* worker = args;
+    struct gameServer* server = worker->server;
+    struct sessionQueue* queue = &worker->queue;
+
+    while (__atomic_load_n(&server->workersRunning, __ATOMIC_SEQ_CST) == 1) {
+        struct serverSession* session = takeSession(queue, 0);
+
+        int peer;
+        // Steal from the other workers, starting with the next one
+        for (peer = 1; session == NULL && peer < server->workerCount; peer++) {
+            session = takeSession(&server->workers[(worker->workerIdx + peer) % server->workerCount].queue, 1);
+        }
+
+        if (session != NULL) {
+            runSession(worker, session);
+            continue;
+        }
+
+        // Sleep until work is queued. Work queued after the checks above sees the sleeping flag and wakes us.
+        pthread_mutex_lock(&queue->lock);
+        __atomic_store_n(&queue->sleeping, 1, __ATOMIC_SEQ_CST);
+        int pending = queue->count;
+        for (peer = 1; pending == 0 && peer < server->workerCount; peer++) {
+            pending = __atomic_load_n(&server->workers[(worker->workerIdx + peer) % server->workerCount].queue.count,
+                                      __ATOMIC_SEQ_CST);
+        }
+        if (pending == 0 && __atomic_load_n(&server->workersRunning, __ATOMIC_SEQ_CST) == 1) {
+            pthread_cond_wait(&queue->ready, &queue->lock);
+        }
+        __atomic_store_n(&queue->sleeping, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    return NULL;
+}
+
+// Initializes a server for a loaded world with workerCount workers, without starting them.
+// Pre-conditions: Pass server, loaded world and number of workers.
+// Post-conditions: Server has no sessions and its workers have empty queues.
+void initializeServer(struct gameServer* server, struct world* world, int workerCount) {
+    memset(server, 0, sizeof(struct gameServer));
+    server->world = world;
+    server->epollFd = -1;
+    server->listenFd = -1;
+    server->workerCount = workerCount;
+    server->workers = calloc(workerCount, sizeof(struct serverWorker));
+    if (server->workers == NULL || pthread_mutex_init(&server->sessionsLock, NULL) != 0) {
+        perror("Error allocating workers");
+        exit(1);
+    }
+
+    int workerIdx;
+    for (workerIdx = 0; workerIdx < workerCount; workerIdx++) {
+        struct serverWorker* worker = &server->workers[workerIdx];
+        worker->server = server;
+        worker->workerIdx = workerIdx;
+        worker->cachedMinute = -1;
+        if (pthread_mutex_init(&worker->queue.lock, NULL) != 0 || pthread_cond_init(&worker->queue.ready, NULL) != 0) {
+            perror("Mutex initialization has failed!\n");
+            exit(1);
+        }
+    }
+}
+
+// Starts the server's worker threads.
+// Pre-conditions: Pass initialized server with its workers stopped.
+// Post-conditions: Workers are running and ready for sessions.
+void startWorkers(struct gameServer* server) {
+    __atomic_store_n(&server->workersRunning, 1, __ATOMIC_SEQ_CST);
+
+    int workerIdx;
+    // Create worker threads and throw error if unable to create
+    for (workerIdx = 0; workerIdx < server->workerCount; workerIdx++) {
+        if (pthread_create(&server->workers[workerIdx].thread, NULL, &serverWorkerThread,
+                           &server->workers[workerIdx]) != 0) {
+            perror("Thread was unable to be created.");
+            exit(1);
+        }
+    }
+}
+
+// Stops the server's worker threads and empties their queues.
+// Pre-conditions: Pass server with its workers running.
+// Post-conditions: Workers have exited. Sessions still queued are left in the session list.
+void stopWorkers(struct gameServer* server) {
+    __atomic_store_n(&server->workersRunning, 0, __ATOMIC_SEQ_CST);
+
+    int workerIdx;
+    for (workerIdx = 0; workerIdx < server->workerCount; workerIdx++) {
+        struct sessionQueue* queue = &server->workers[workerIdx].queue;
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_signal(&queue->ready);
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    for (workerIdx = 0; workerIdx < server->workerCount; workerIdx++) {
+        pthread_join(server->workers[workerIdx].thread, NULL);
+        server->workers[workerIdx].queue.head = 0;
+        server->workers[workerIdx].queue.count = 0;
+    }
+}
+
+// Closes every session and frees the server and its workers.
+// Pre-conditions: Pass server with its workers stopped.
+// Post-conditions: Server memory is freed.
+void freeServer(struct gameServer* server) {
+    while (server->sessionCount > 0) {
+        closeSession(server, server->sessions[server->sessionCount - 1]);
+    }
+    free(server->sessions);
+
+    int workerIdx;
+    for (workerIdx = 0; workerIdx < server->workerCount; workerIdx++) {
+        free(server->workers[workerIdx].queue.sessions);
+        pthread_cond_destroy(&server->workers[workerIdx].queue.ready);
+        pthread_mutex_destroy(&server->workers[workerIdx].queue.lock);
+    }
+    free(server->workers);
+    pthread_mutex_destroy(&server->sessionsLock);
+}
+
+// Accepts every pending connection on the listening socket and greets each new session with its start room.
+// Pre-conditions: Pass listening server.
+// Post-conditions: New sessions are registered with the epoll instance.
+void acceptSessions(struct gameServer* server) {
+    while (1) {
+        int fd = accept4(server->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("Error accepting session");
             }
+            return;
+        }
+
+        // Greet the session before it is registered, while no worker can hold it yet
+        struct serverSession* session = createSession(server, fd);
+        appendLocation(server->world, session);
+        appendString(session, "WHERE TO? >");
+        flushSession(session);
+
+        struct epoll_event event;
+        event.data.ptr = session;
+        event.events = EPOLLONESHOT | (session->outputLength > 0 ? EPOLLOUT : EPOLLIN | EPOLLRDHUP);
+        if (session->closing == 1 || epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            closeSession(server, session);
+        }
+    }
+}
+
+// Runs the game server. The world is loaded once and shared read only by every session. A single epoll loop
+// accepts players on a UNIX domain socket at socketPath and queues each session with input on its worker, and
+// workerCount worker threads run the sessions' commands. Each session plays the same game as the terminal, one
+// line per command. Runs until interrupted with SIGINT or SIGTERM.
+// Pre-conditions: Pass loaded world, path of socket to create and number of worker threads.
+// Post-conditions: Returns 1 after a clean shutdown, otherwise 0 with error output.
+int runServer(struct world* world, const char* socketPath, int workerCount) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(struct sockaddr_un));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socketPath);
+        return 0;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    struct gameServer server;
+    initializeServer(&server, world, workerCount);
+
+    // Create listening socket, replacing a socket left behind by an earlier server
+    server.listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(socketPath);
+    if (server.listenFd == -1 || bind(server.listenFd, (struct sockaddr*) &address, sizeof(address)) != 0
+        || listen(server.listenFd, SOMAXCONN) != 0) {
+        perror("Error creating server socket");
+        return 0;
+    }
 
+    server.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (server.epollFd == -1 || epoll_ctl(server.epollFd, EPOLL_CTL_ADD, server.listenFd, &event) != 0) {
+        perror("Error creating epoll instance");
+        return 0;
+    }
+
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    startWorkers(&server);
+    printf("Serving %d rooms on %s with %d workers\n", world->roomCount, socketPath, workerCount);
+    fflush(stdout);
+
+    struct epoll_event events[256];
+    // Dispatch events until stopped
+    while (serverRunning == 1) {
+        int eventCount = epoll_wait(server.epollFd, events, 256, -1);
+        if (eventCount == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Error waiting for events");
             break;
         }
 
+        int eventIdx;
+        for (eventIdx = 0; eventIdx < eventCount; eventIdx++) {
+            struct serverSession* session = events[eventIdx].data.ptr;
+
+            // Listening socket has new connections, sessions have input or room for output
+            if (session == NULL) {
+                acceptSessions(&server);
+            }
+            else {
+                scheduleSession(&server, &server.workers[session->homeWorker], session);
+            }
+        }
+    }
+
+    // Stop workers before closing every session and the server
+    stopWorkers(&server);
+    close(server.epollFd);
+    close(server.listenFd);
+    unlink(socketPath);
+    freeServer(&server);
+
+    return 1;
+}
+
+// Returns seconds elapsed since a start time.
+// Pre-conditions: Pass start time read from the monotonic clock.
+// Post-conditions: Returns elapsed seconds.
+double secondsSince(struct timespec* startTime) {
+    struct timespec endTime;
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+    return (double) (endTime.tv_sec - startTime->tv_sec) + (endTime.tv_nsec - startTime->tv_nsec) / 1e9;
+}
+
+// Benchmarks finding the newest world in a directory of entryCount empty packed world files, comparing the
+// getdents64 scan with the readdir and stat scan. The directory is created in the current location and removed
+// afterwards.
+// Pre-conditions: Pass number of directory entries to create.
+// Post-conditions: Timings of both scans are outputted.
+void benchmarkScan(int entryCount) {
+    char benchDir[64];
+    sprintf(benchDir, "trompj.scanbench.%d", getpid());
+    if (mkdir(benchDir, 0755) != 0) {
+        perror("Error creating benchmark directory");
+        exit(1);
     }
 
-    int i = 0;
-    // Free visited rooms character arrays
-    for (i; i < stepCount; i++) {
-        free(visitedRooms[i]);
+    int dirFd = open(benchDir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd == -1) {
+        perror("Error opening benchmark directory");
+        exit(1);
     }
-    free(visitedRooms);
 
-    // Destroy mutex
-    pthread_mutex_destroy(&threadVars->lock);
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    int entry;
+    char entryName[64];
+    // Fill directory with world files
+    for (entry = 0; entry < entryCount; entry++) {
+        sprintf(entryName, "%s%d%s", WORLD_NAME_PREFIX, entry + 1, WORLD_FILE_SUFFIX);
+        int fd = openat(dirFd, entryName, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            perror("Error creating benchmark entry");
+            exit(1);
+        }
+        close(fd);
+    }
+    printf("Created %d entries in %.3f seconds\n", entryCount, secondsSince(&startTime));
+
+    char newest[128];
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    scanNewestWorldByStat(benchDir, newest);
+    double statSeconds = secondsSince(&startTime);
+    printf("readdir and stat: %s in %.3f seconds (%.0f entries/second)\n", newest, statSeconds,
+           entryCount / statSeconds);
+
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    scanNewestWorld(benchDir, newest);
+    double scanSeconds = secondsSince(&startTime);
+    printf("getdents64: %s in %.3f seconds (%.0f entries/second, %.1fx faster)\n", newest, scanSeconds,
+           entryCount / scanSeconds, statSeconds / scanSeconds);
+
+    // Remove benchmark directory
+    for (entry = 0; entry < entryCount; entry++) {
+        sprintf(entryName, "%s%d%s", WORLD_NAME_PREFIX, entry + 1, WORLD_FILE_SUFFIX);
+        unlinkat(dirFd, entryName, 0);
+    }
+    close(dirFd);
+    rmdir(benchDir);
+}
+
+// Benchmarks the game server's worker pool without sockets. Each of sessionCount sessions gets a script of
+// movesPerSession random moves, and the scripts are run with 1, 2, 4 and so on up to maxWorkers workers.
+// Pre-conditions: Pass loaded world, number of sessions, moves per session and most workers to run.
+// Post-conditions: Moves per second for each worker count are outputted.
+void benchmarkWorkers(struct world* world, int sessionCount, int movesPerSession, int maxWorkers) {
+    char** scripts = malloc(sizeof(char*) * sessionCount);
+    size_t* scriptLengths = malloc(sizeof(size_t) * sessionCount);
+    if (scripts == NULL || scriptLengths == NULL) {
+        perror("Error allocating scripts");
+        exit(1);
+    }
+
+    int sessionIdx;
+    // Write a random walk for every session, starting over from the start room like the server does
+    for (sessionIdx = 0; sessionIdx < sessionCount; sessionIdx++) {
+        scripts[sessionIdx] = malloc((size_t) movesPerSession * WORLD_NAME_SIZE);
+        if (scripts[sessionIdx] == NULL) {
+            perror("Error allocating scripts");
+            exit(1);
+        }
+
+        uint32_t random = (uint32_t) sessionIdx * 2654435761u + 1;
+        int currentRoom = world->startRoom;
+        size_t length = 0;
+        int move;
+        for (move = 0; move < movesPerSession; move++) {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+
+            const struct packedRoom* roomObj = &world->rooms[currentRoom];
+            int nextRoom = (int) world->connections[roomObj->firstConnection + random % roomObj->connectionCount];
+            length += (size_t) sprintf(&scripts[sessionIdx][length], "%s\n", roomName(world, nextRoom));
+            currentRoom = world->rooms[nextRoom].type == ROOM_TYPE_END ? world->startRoom : nextRoom;
+        }
+        scriptLengths[sessionIdx] = length;
+    }
+
+    double oneWorkerRate = 0;
+    int workerCount = 1;
+    // Run the scripts with each worker count
+    while (workerCount <= maxWorkers) {
+        struct gameServer server;
+        initializeServer(&server, world, workerCount);
+
+        for (sessionIdx = 0; sessionIdx < sessionCount; sessionIdx++) {
+            struct serverSession* session = createSession(&server, -1);
+            session->script = scripts[sessionIdx];
+            session->scriptLength = scriptLengths[sessionIdx];
+        }
+
+        struct timespec startTime;
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+        startWorkers(&server);
+
+        for (sessionIdx = 0; sessionIdx < sessionCount; sessionIdx++) {
+            struct serverSession* session = server.sessions[sessionIdx];
+            scheduleSession(&server, &server.workers[session->homeWorker], session);
+        }
+
+        // Wait for every script to finish
+        struct timespec pause = { 0, 100000 };
+        while (__atomic_load_n(&server.finishedScripts, __ATOMIC_SEQ_CST) < sessionCount) {
+            nanosleep(&pause, NULL);
+        }
+        double seconds = secondsSince(&startTime);
+        stopWorkers(&server);
+        freeServer(&server);
+
+        double rate = (double) sessionCount * movesPerSession / seconds;
+        if (workerCount == 1) {
+            oneWorkerRate = rate;
+        }
+        printf("%d workers: %ld moves in %.3f seconds (%.0f moves/second, %.2fx)\n", workerCount,
+               (long) sessionCount * movesPerSession, seconds, rate, rate / oneWorkerRate);
+
+        // Double the workers, finishing with exactly maxWorkers
+        if (workerCount < maxWorkers && workerCount * 2 > maxWorkers) {
+            workerCount = maxWorkers;
+        }
+        else {
+            workerCount *= 2;
+        }
+    }
+
+    for (sessionIdx = 0; sessionIdx < sessionCount; sessionIdx++) {
+        free(scripts[sessionIdx]);
+    }
+    free(scripts);
+    free(scriptLengths);
+}
+
+// Benchmarks stepping a batch of sessionCount sessions stepCount times on a world. Actions are random room ids
+// drawn ahead of time, so the timing only covers stepBatch and resetting finished sessions.
+// Pre-conditions: Pass loaded world, number of sessions and number of steps.
+// Post-conditions: Session steps per second are outputted.
+void benchmarkBatch(struct world* world, int sessionCount, int stepCount) {
+    struct sessionBatch batch;
+    if (initializeBatch(&batch, world, sessionCount) == 0) {
+        exit(1);
+    }
+
+    // Rotate through a few arrays of actions so the benchmark isn't bound by drawing random numbers
+    int actionSets = 16;
+    int32_t* actions = malloc(sizeof(int32_t) * (size_t) sessionCount * actionSets);
+    if (actions == NULL) {
+        perror("Error allocating actions");
+        exit(1);
+    }
+
+    uint32_t random = 1;
+    size_t actionIdx;
+    for (actionIdx = 0; actionIdx < (size_t) sessionCount * actionSets; actionIdx++) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        actions[actionIdx] = (int32_t) (random % (uint32_t) world->roomCount);
+    }
+
+    long moved = 0;
+    long finished = 0;
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    int step;
+    for (step = 0; step < stepCount; step++) {
+        moved += stepBatch(&batch, &actions[(size_t) (step % actionSets) * sessionCount]);
+        finished += resetFinished(&batch);
+    }
+
+    double seconds = secondsSince(&startTime);
+    double sessionSteps = (double) sessionCount * stepCount;
+    printf("%.0f session steps in %.3f seconds (%.0f session steps/second, %s)\n", sessionSteps, seconds,
+           sessionSteps / seconds, batch.neighborMasks != NULL ? "neighbour masks" : "connection lists");
+    printf("%ld valid moves, %ld games finished\n", moved, finished);
+
+    free(actions);
+    freeBatch(&batch);
+}
+
+// Solves the world from its start room and outputs a shortest path to the end room.
+// Pre-conditions: Pass loaded world.
+// Post-conditions: Shortest path and its length are outputted. Returns 1 if the end room can be reached, otherwise 0.
+int printSolution(struct world* world) {
+    struct pathLog path;
+    initializePathLog(&path);
+
+    int steps = solveWorld(world, world->startRoom, &path);
+    if (steps == -1) {
+        printf("THE END ROOM CANNOT BE REACHED FROM %s.\n", roomName(world, world->startRoom));
+    }
+    else {
+        printf("SHORTEST PATH FROM %s TAKES %d STEPS:\n", roomName(world, world->startRoom), steps);
+
+        int roomIdx;
+        // Loop through path and output rooms visited
+        for (roomIdx = 0; roomIdx < path.count; roomIdx++) {
+            printf("%s\n", roomName(world, path.rooms[roomIdx]));
+        }
+    }
+
+    freePathLog(&path);
+
+    return steps != -1;
+}
+
+// Work shared by the threads of a solvability check. Threads claim worlds one at a time from nextWorld and store
+// each world's shortest path length in steps: -1 when the end room cannot be reached, -2 when it failed to load.
+struct checkJob {
+    char** worldNames;
+    int worldCount;
+    int nextWorld;
+    int* steps;
+};
+
+// Thread function for the solvability check. Loads, solves and frees claimed worlds until all are claimed.
+// Pre-conditions: Must be passed a checkJob struct pointer.
+// Post-conditions: Steps of every claimed world are set.
+void* checkWorldsThread(void* args) {
+    struct checkJob* job = args;
+    struct pathLog path;
+    initializePathLog(&path);
+
+    while (1) {
+        int worldNum = __atomic_fetch_add(&job->nextWorld, 1, __ATOMIC_RELAXED);
+        if (worldNum >= job->worldCount) {
+            break;
+        }
+
+        struct world world;
+        if (loadWorld(job->worldNames[worldNum], &world) == 0) {
+            job->steps[worldNum] = -2;
+        }
+        else {
+            job->steps[worldNum] = solveWorld(&world, world.startRoom, &path);
+        }
+        freeWorld(&world);
+    }
+
+    freePathLog(&path);
+
+    return NULL;
+}
+
+// Checks that the end room can be reached from the start room in every world listed in listName, one world file
+// or directory per line ("-" reads the list from standard input). Worlds are checked on threadCount threads.
+// Pre-conditions: Pass name of world list and number of threads.
+// Post-conditions: Unsolvable worlds and a summary with throughput are outputted. Returns number of worlds that are
+// unsolvable or failed to load.
+int checkWorlds(const char* listName, int threadCount) {
+    FILE* listFile = strcmp(listName, "-") == 0 ? stdin : fopen(listName, "r");
+    if (listFile == NULL) {
+        perror("Error opening world list");
+        return 1;
+    }
+
+    struct checkJob job;
+    job.worldNames = NULL;
+    job.worldCount = 0;
+    job.nextWorld = 0;
+    int capacity = 0;
+
+    char lineRead[256];
+    // Read world names, skipping blank lines
+    while (fgets(lineRead, sizeof(lineRead), listFile) != NULL) {
+        lineRead[strcspn(lineRead, "\r\n")] = '\0';
+        if (lineRead[0] == '\0') {
+            continue;
+        }
+
+        if (job.worldCount == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            job.worldNames = realloc(job.worldNames, sizeof(char*) * capacity);
+            if (job.worldNames == NULL) {
+                perror("Error allocating world list");
+                exit(1);
+            }
+        }
+        job.worldNames[job.worldCount] = strdup(lineRead);
+        job.worldCount++;
+    }
+    if (listFile != stdin) {
+        fclose(listFile);
+    }
+
+    job.steps = malloc(sizeof(int) * (job.worldCount + 1));
+    pthread_t* threads = malloc(sizeof(pthread_t) * threadCount);
+    if (job.steps == NULL || threads == NULL) {
+        perror("Error allocating threads");
+        exit(1);
+    }
+
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    int i;
+    // Start checker threads and throw error if unable to create
+    for (i = 0; i < threadCount; i++) {
+        if (pthread_create(&threads[i], NULL, &checkWorldsThread, &job) != 0) {
+            perror("Thread was unable to be created.");
+            exit(1);
+        }
+    }
+
+    // Wait for every checker to finish
+    for (i = 0; i < threadCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double seconds = secondsSince(&startTime);
+
+    int solvable = 0;
+    int unsolvable = 0;
+    int failed = 0;
+    long totalSteps = 0;
+    int longest = 0;
+    // Report worlds that can't be played and total up the rest
+    for (i = 0; i < job.worldCount; i++) {
+        if (job.steps[i] == -2) {
+            printf("%s: FAILED TO LOAD\n", job.worldNames[i]);
+            failed++;
+        }
+        else if (job.steps[i] == -1) {
+            printf("%s: UNSOLVABLE\n", job.worldNames[i]);
+            unsolvable++;
+        }
+        else {
+            solvable++;
+            totalSteps += job.steps[i];
+            if (job.steps[i] > longest) {
+                longest = job.steps[i];
+            }
+        }
+        free(job.worldNames[i]);
+    }
+
+    printf("Checked %d worlds with %d threads in %.3f seconds (%.0f worlds/second)\n", job.worldCount, threadCount,
+           seconds, job.worldCount / seconds);
+    printf("%d solvable (average %.2f steps, longest %d), %d unsolvable, %d failed to load\n", solvable,
+           solvable > 0 ? (double) totalSteps / solvable : 0.0, longest, unsolvable, failed);
+
+    free(job.worldNames);
+    free(job.steps);
+    free(threads);
+
+    return unsolvable + failed;
+}
+
+// Parses a positive integer command line value for the given option. Exits with a usage error if invalid.
+// Pre-conditions: Pass option name for error output and string value to parse.
+// Post-conditions: Returns parsed integer value.
+int parseCountArg(char* option, char* value) {
+    char* end = NULL;
+    long parsed = strtol(value, &end, 10);
+
+    if (end == value || *end != '\0' || parsed < 1 || parsed > 100000000) {
+        fprintf(stderr, "Invalid value for %s: %s\n", option, value);
+        exit(1);
+    }
+
+    return (int) parsed;
 }
 
 // Main function to link all pieces of adventure process
-int main() {
+int main(int argc, char* argv[]) {
+    int timeTransport = TIME_TRANSPORT_MEMORY;
+    const char* timeFile = "currentTime.txt";
+    const char* socketPath = NULL;
+    int benchSessions = 0;
+    int benchMoves = 0;
+    int batchSessions = 0;
+    int batchSteps = 0;
+    int solve = 0;
+    int batch = 0;
+    const char* worldList = NULL;
+    int cacheRooms = ROOM_CACHE_DEFAULT_ROOMS;
+    int workerCount = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (workerCount < 1) {
+        workerCount = 1;
+    }
+
+    int arg;
+    // Read options
+    for (arg = 1; arg < argc; arg++) {
+        // Directory scan benchmark instead of a game
+        if (strcmp(argv[arg], "--bench-scan") == 0 && arg + 1 < argc) {
+            benchmarkScan(parseCountArg(argv[arg], argv[arg + 1]));
+            return 0;
+        }
+        else if (strcmp(argv[arg], "--time-transport") == 0 && arg + 1 < argc) {
+            if (strcmp(argv[arg + 1], "memory") == 0) {
+                timeTransport = TIME_TRANSPORT_MEMORY;
+            }
+            else if (strcmp(argv[arg + 1], "pipe") == 0) {
+                timeTransport = TIME_TRANSPORT_PIPE;
+            }
+            else if (strcmp(argv[arg + 1], "file") == 0) {
+                timeTransport = TIME_TRANSPORT_FILE;
+            }
+            else {
+                fprintf(stderr, "Invalid value for %s: %s\n", argv[arg], argv[arg + 1]);
+                return 1;
+            }
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--serve") == 0 && arg + 1 < argc) {
+            socketPath = argv[arg + 1];
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--workers") == 0 && arg + 1 < argc) {
+            workerCount = parseCountArg(argv[arg], argv[arg + 1]);
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--bench-workers") == 0 && arg + 2 < argc) {
+            benchSessions = parseCountArg(argv[arg], argv[arg + 1]);
+            benchMoves = parseCountArg(argv[arg], argv[arg + 2]);
+            arg += 2;
+        }
+        else if (strcmp(argv[arg], "--room-cache") == 0 && arg + 1 < argc) {
+            cacheRooms = parseCountArg(argv[arg], argv[arg + 1]);
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--solve") == 0) {
+            solve = 1;
+        }
+        else if (strcmp(argv[arg], "--batch") == 0) {
+            batch = batch == 0 ? 1 : batch;
+        }
+        else if (strcmp(argv[arg], "--batch-verbose") == 0) {
+            batch = 2;
+        }
+        else if (strcmp(argv[arg], "--check-worlds") == 0 && arg + 1 < argc) {
+            worldList = argv[arg + 1];
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--bench-batch") == 0 && arg + 2 < argc) {
+            batchSessions = parseCountArg(argv[arg], argv[arg + 1]);
+            batchSteps = parseCountArg(argv[arg], argv[arg + 2]);
+            arg += 2;
+        }
+        else if (strcmp(argv[arg], "--time-file") == 0 && arg + 1 < argc) {
+            timeTransport = TIME_TRANSPORT_FILE;
+            timeFile = argv[arg + 1];
+            arg++;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--time-transport memory|pipe|file] [--time-file PATH] [--serve PATH] "
+                            "[--workers N] [--room-cache N] [--solve] [--batch] [--batch-verbose] "
+                            "[--check-worlds LIST] [--bench-workers SESSIONS MOVES] [--bench-batch SESSIONS STEPS] "
+                            "[--bench-scan N]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    // Check a list of worlds instead of playing the newest one
+    if (worldList != NULL) {
+        return checkWorlds(worldList, workerCount) == 0 ? 0 : 1;
+    }
+
     // Determine which directory has the most recent rooms
     char dirName[128];
     memset(dirName, '\0', 128);
     mostRecentRooms(dirName);
 
-    struct room roomArr[7];
-    int i = 0;
-    // Loop through array and initialize values in structs
-    for (i; i < sizeof(roomArr) / sizeof(struct room); i++) {
-        initializeData(&roomArr[i]);
+    // Only terminal games page their world, the other modes search or share all of it
+    int paged = solve == 0 && batch == 0 && benchSessions == 0 && batchSessions == 0 && socketPath == NULL;
+
+    struct world world;
+    // Set rooms with applicable information from the newest world file or directory of room files. Terminal games
+    // compile a directory of room files into its cache, so the next game starts without parsing them.
+    struct stat worldAttributes;
+    int loaded;
+    if (paged == 1 && stat(dirName, &worldAttributes) == 0 && S_ISDIR(worldAttributes.st_mode)) {
+        loaded = loadWorldCached(dirName, &world);
+    }
+    else if (paged == 1) {
+        loaded = loadPagedWorld(dirName, &world, cacheRooms);
+    }
+    else {
+        loaded = loadWorld(dirName, &world);
+    }
+    if (loaded == 0) {
+        freeWorld(&world);
+        return 1;
+    }
+
+    // Output a shortest path through the world instead of playing it
+    if (solve == 1) {
+        int solvable = printSolution(&world);
+        freeWorld(&world);
+        return solvable == 1 ? 0 : 1;
     }
 
-    // Set room array with applicable information from room files found in newest directory
-    setRoomArray(dirName, roomArr);
+    // Play a move script from stdin instead of the terminal
+    if (batch > 0) {
+        int played = runBatch(&world, batch == 2 ? 1 : 0);
+        freeWorld(&world);
+        return played == 1 ? 0 : 1;
+    }
 
-    // Runs adventure until user reached end condition by reaching the end room
-    runGameDriver(roomArr);
-
-    i = 0;
-    // Free all memory allocations in room struct objects for room connections
-    for (i; i < 7; i++) {
-        int x = 0;
-        // Loop through all room connections and free allocated memory
-        for (x; x < 6; x++) {
-            if (roomArr[i].roomConnections[x] == NULL) {
-                break;
-            }
-            else {
-                free(roomArr[i].roomConnections[x]);
-            }
-        }
+    // Time the server's worker pool on the world
+    if (benchSessions > 0) {
+        benchmarkWorkers(&world, benchSessions, benchMoves, workerCount);
+        freeWorld(&world);
+        return 0;
+    }
+
+    // Time stepping a session batch on the world
+    if (batchSessions > 0) {
+        benchmarkBatch(&world, batchSessions, batchSteps);
+        freeWorld(&world);
+        return 0;
+    }
 
-        // Free allocated memory for room name and room type
-        free(roomArr[i].roomName);
-        free(roomArr[i].roomType);
+    // Serve players over the socket until stopped
+    if (socketPath != NULL) {
+        int served = runServer(&world, socketPath, workerCount);
+        freeWorld(&world);
+        return served == 1 ? 0 : 1;
     }
 
+    // Runs adventure until user reached end condition by reaching the end room
+    runGameDriver(&world, timeTransport, timeFile);
+
+    freeWorld(&world);
+
     return 0;
-}
\ No newline at end of file
+}
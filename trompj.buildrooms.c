@@ -2,78 +2,289 @@
 // Date: 04/25/2020
 // Description: Buildrooms randomly selects 7 out of 10 preset room names and randomly applies values to them such
 // as type of room (start, end, or mid) and 3-6 randomly generated connections to other rooms. These values along with
-// the name of the room selected are each outputted to a room file in a new directory appended with pid for each run.
+// the name of the room selected are each outputted to a packed world file (see trompj.world.h) appended with pid for
+// each run. With --text, each room is outputted to a room file in a new directory appended with pid instead.
+// --batch builds many worlds per run on a pool of threads, each appended with pid and world number. After each run
+// the trompj.latest_rooms symlink points at the newest world so adventure can find it without scanning.
+// Larger worlds can be generated with --rooms, --min-degree and --max-degree, in which case rooms are named
+// Room0 through Room<N-1>.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <zconf.h>
 #include <memory.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "trompj.world.h"
 
-// Sets all positions on 7x7 matrix graph to -1.
-// Pre-conditions: Receives a 7x7 matrix int graph as parameter.
-// Post-conditions: All positions in parameter matrix are set to -1.
-void initializeGraph(int roomGraph[7][7]) {
+// Buffer size for generated room names ("Room" followed by up to 9 digits)
+#define ROOM_NAME_SIZE 14
 
-    int x;
-    for (x = 0; x < 7; x++) {
-        int y;
-        for (y = 0; y < 7; y++) {
-            roomGraph[x][y] = -1;
-        }
+// Random picks tried before falling back to a scan when looking for a room to connect to
+#define CONNECTION_ATTEMPTS 8
+
+// Rewires allowed per room before giving up on degrees that can't be satisfied
+#define REWIRE_LIMIT_PER_ROOM 4
+
+// Largest world that keeps an adjacency bit row per room (2 MB of rows at this size)
+#define BITSET_ROOM_LIMIT 4096
+
+// Worlds claimed at a time by each batch thread
+#define BATCH_CHUNK_SIZE 64
+
+// State of the xoshiro256** random number generator. Each world or thread owns its own state, so generation never
+// shares the global rand() state and any run can be replayed from its seed.
+struct rngState {
+    uint64_t s[4];
+};
+
+// Advances a splitmix64 state and returns its next output. Used to expand a seed into a full generator state.
+// Pre-conditions: Pass pointer to splitmix64 state.
+// Post-conditions: State is advanced and the next 64 bit output is returned.
+uint64_t splitMix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+// Seeds a generator for one stream of a seed. Different stream numbers of the same seed give independent sequences,
+// so each thread or world can draw from its own stream and results don't depend on scheduling.
+// Pre-conditions: Pass generator state, seed and stream number.
+// Post-conditions: Generator state is fully initialized.
+void rngSeed(struct rngState* rng, uint64_t seed, uint64_t stream) {
+    uint64_t mix = seed;
+    uint64_t streamMix = stream;
+    mix ^= splitMix64(&streamMix);
+
+    int i;
+    for (i = 0; i < 4; i++) {
+        rng->s[i] = splitMix64(&mix);
     }
+}
 
+// Returns the next 64 bit output of a xoshiro256** generator.
+// Pre-conditions: Pass seeded generator state.
+// Post-conditions: State is advanced and the next output is returned.
+uint64_t rngNext(struct rngState* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = s[1] * 5;
+    result = ((result << 7) | (result >> 57)) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+
+    return result;
 }
 
-// Checks if graph passed as parameter is full according to build rooms rules. Each room must have 3 or more
-// and less than 7 room connections. This function checks number of connections by analyzing how many positions
-// are still set to -1 (unset).
-// Pre-conditions: Pass 7x7 int matrix as parameter to analyze values.
-// Post-conditions: Returns 1 if graph is full or 0 if not full.
-int isGraphFull(int roomGraph[7][7]) {
-    int roomConnections[7] = { 0, 0, 0, 0, 0, 0, 0 };
-    int x;
-    int y;
-
-    // Loop through room matrix and increase counter for room connections array if a room is found
-    for (x = 0; x < 7; x++) {
-        for (y = 0; y < 7; y++) {
-            if (roomGraph[x][y] != -1) {
-                roomConnections[x] += 1;
-            }
-        }
+// Returns a random number in the range 0 to bound-1 using a multiply and shift instead of a modulo.
+// Pre-conditions: Pass seeded generator state and a bound between 1 and 2^32.
+// Post-conditions: Returns random value below bound.
+int rngBelow(struct rngState* rng, int bound) {
+    return (int) (((rngNext(rng) >> 32) * (uint64_t) bound) >> 32);
+}
+
+// Picks a seed when none was given on the command line. Mixes wall clock nanoseconds with the process ID so that
+// two runs in the same second still differ.
+// Pre-conditions: None
+// Post-conditions: Returns seed value.
+uint64_t defaultSeed() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    uint64_t mix = ((uint64_t) now.tv_sec << 32) ^ (uint64_t) now.tv_nsec ^ ((uint64_t) getpid() << 16);
+
+    return splitMix64(&mix);
+}
+
+// Sparse graph of room connections. Each room owns a slice of maxDegree entries in the connections array that
+// holds the ids of the rooms it is connected to, so memory grows with the number of edges rather than with the
+// square of the number of rooms. Two live room sets are kept up to date as connections change: rooms with fewer
+// than minDegree connections (underMinRooms) and rooms with fewer than maxDegree connections (openRooms). Each set
+// stores its rooms densely with a position array per room, so adding, removing and random picks are O(1).
+// Worlds of up to BITSET_ROOM_LIMIT rooms also keep an adjacency bit row per room, so checking for a connection is a
+// single bit test. Worlds of up to 64 rooms fit each row in one word, and keep the open set as a word as well.
+struct roomGraph {
+    int roomCount;
+    int minDegree;
+    int maxDegree;
+    int* degrees;
+    int* connections;
+
+    int bitWords;
+    uint64_t* roomBits;
+    uint64_t openMask;
+
+    int underMinCount;
+    int* underMinRooms;
+    int* underMinPos;
+
+    int openCount;
+    int* openRooms;
+    int* openPos;
+
+    struct rngState* rng;
+};
+
+// Adds a room to a live room set.
+// Pre-conditions: Pass set arrays, pointer to set count and a room not already in the set.
+// Post-conditions: Room is appended to the set and its position recorded.
+void addToRoomSet(int* rooms, int* positions, int* count, int room) {
+    rooms[*count] = room;
+    positions[room] = *count;
+    (*count)++;
+}
+
+// Removes a room from a live room set by moving the last room of the set into its place.
+// Pre-conditions: Pass set arrays, pointer to set count and a room currently in the set.
+// Post-conditions: Room is removed from the set and the moved room's position is updated.
+void removeFromRoomSet(int* rooms, int* positions, int* count, int room) {
+    int pos = positions[room];
+    int lastRoom = rooms[*count - 1];
+
+    rooms[pos] = lastRoom;
+    positions[lastRoom] = pos;
+    positions[room] = -1;
+    (*count)--;
+}
+
+// Picks a set bit from a non-zero word without looping by rotating the word a random amount and taking the lowest
+// set bit. Bits that follow a run of clear bits are picked a little more often, which is fine for room generation.
+// Pre-conditions: Pass a word with at least one bit set.
+// Post-conditions: Returns the index of one of the set bits.
+int pickRandomBit(struct rngState* rng, uint64_t mask) {
+    int shift = rngBelow(rng, 64);
+    uint64_t rotated = shift == 0 ? mask : (mask >> shift) | (mask << (64 - shift));
+
+    return (__builtin_ctzll(rotated) + shift) % 64;
+}
+
+// Removes every connection from a graph so it can be reused for another world without reallocating.
+// Pre-conditions: Graph was set up with initializeGraph.
+// Post-conditions: Every room has 0 connections and is in both live room sets.
+void resetGraph(struct roomGraph* graph) {
+    int roomCount = graph->roomCount;
+
+    memset(graph->degrees, 0, sizeof(int) * roomCount);
+    if (graph->roomBits != NULL) {
+        memset(graph->roomBits, 0, sizeof(uint64_t) * (size_t) roomCount * graph->bitWords);
+    }
+    graph->openMask = 0;
+    if (graph->bitWords == 1) {
+        graph->openMask = roomCount == 64 ? ~0ULL : (1ULL << roomCount) - 1;
     }
 
-    int idx;
-    int graphFull = 1;
-    // Loop through room counts to see if any are less than 3, if so then the graph is not full.
-    for (idx = 0; idx < 7; idx++) {
-        if (roomConnections[idx] < 3) {
-            graphFull = 0;
+    graph->underMinCount = 0;
+    graph->openCount = 0;
+
+    int room;
+    // Every room starts with no connections
+    for (room = 0; room < roomCount; room++) {
+        addToRoomSet(graph->underMinRooms, graph->underMinPos, &graph->underMinCount, room);
+        addToRoomSet(graph->openRooms, graph->openPos, &graph->openCount, room);
+    }
+}
+
+// Allocates a graph for roomCount rooms with no connections.
+// Pre-conditions: Pass graph struct pointer, number of rooms, the minimum/maximum connections per room and the
+// random generator to draw connections from.
+// Post-conditions: Graph arrays are allocated and the graph is reset to no connections. Exits on allocation failure.
+void initializeGraph(struct roomGraph* graph, int roomCount, int minDegree, int maxDegree, struct rngState* rng) {
+    graph->rng = rng;
+    graph->roomCount = roomCount;
+    graph->minDegree = minDegree;
+    graph->maxDegree = maxDegree;
+    graph->degrees = malloc(sizeof(int) * roomCount);
+    graph->connections = malloc(sizeof(int) * (size_t) roomCount * maxDegree);
+    graph->underMinRooms = malloc(sizeof(int) * roomCount);
+    graph->underMinPos = malloc(sizeof(int) * roomCount);
+    graph->openRooms = malloc(sizeof(int) * roomCount);
+    graph->openPos = malloc(sizeof(int) * roomCount);
+
+    // Bit rows are only kept while they stay small
+    graph->bitWords = 0;
+    graph->roomBits = NULL;
+    if (roomCount <= BITSET_ROOM_LIMIT) {
+        graph->bitWords = (roomCount + 63) / 64;
+        graph->roomBits = malloc(sizeof(uint64_t) * (size_t) roomCount * graph->bitWords);
+        if (graph->roomBits == NULL) {
+            perror("Error allocating room graph");
+            exit(1);
         }
     }
 
+    if (graph->degrees == NULL || graph->connections == NULL || graph->underMinRooms == NULL
+        || graph->underMinPos == NULL || graph->openRooms == NULL || graph->openPos == NULL) {
+        perror("Error allocating room graph");
+        exit(1);
+    }
+
+    resetGraph(graph);
+}
+
+// Frees memory held by the graph arrays.
+// Pre-conditions: Graph was set up with initializeGraph.
+// Post-conditions: Graph arrays are freed and set to NULL.
+void freeGraph(struct roomGraph* graph) {
+    free(graph->degrees);
+    free(graph->connections);
+    free(graph->underMinRooms);
+    free(graph->underMinPos);
+    free(graph->openRooms);
+    free(graph->openPos);
+    free(graph->roomBits);
+    graph->degrees = NULL;
+    graph->connections = NULL;
+    graph->underMinRooms = NULL;
+    graph->underMinPos = NULL;
+    graph->openRooms = NULL;
+    graph->openPos = NULL;
+    graph->roomBits = NULL;
+}
+
+// Checks if graph passed as parameter is full according to build rooms rules. Each room must have minDegree or more
+// and at most maxDegree room connections. The set of rooms under the minimum is kept up to date as connections are
+// made, so no rows need to be recounted.
+// Pre-conditions: Pass graph struct pointer to analyze values.
+// Post-conditions: Returns 1 if graph is full or 0 if not full.
+int isGraphFull(struct roomGraph* graph) {
+    int graphFull = 0;
+
+    if (graph->underMinCount == 0) {
+        graphFull = 1;
+    }
+
     return graphFull;
 }
 
+// Returns the number of connections a room has. Rooms of worlds with one word bit rows count their bits.
+// Pre-conditions: Pass graph and the room in question as int value room.
+// Post-conditions: Returns number of connections of room.
+int roomDegree(struct roomGraph* graph, int room) {
+    if (graph->bitWords == 1) {
+        return __builtin_popcountll(graph->roomBits[room]);
+    }
+
+    return graph->degrees[room];
+}
+
 // Determines if you can still add a connection from the room selected. If so, returns 1, otherwise returns 0.
-// Pre-conditions: Pass room matrix (7x7) with current room connections and the room in question as int value room.
+// Pre-conditions: Pass graph with current room connections and the room in question as int value room.
 // Post-conditions: Returns 1 if room can have another connection, otherwise returns 0.
-int canAddConnectionFrom(int rooms[7][7], int room) {
+int canAddConnectionFrom(struct roomGraph* graph, int room) {
     int canAdd = 0;
 
-    int roomCount = 0;
-    int idx;
-    // Loop through room and count number of rooms assigned, if less than 6
-    for (idx = 0; idx < 7; idx++) {
-        if (rooms[room][idx] != -1) {
-            roomCount++;
-        }
-    }
-
-    // Set if less than 6 assignments to allow adding another room
-    if (roomCount < 6) {
+    // Set if less than maxDegree assignments to allow adding another room
+    if (roomDegree(graph, room) < graph->maxDegree) {
         canAdd = 1;
     }
 
@@ -94,73 +305,236 @@ int isSameRoom(int roomA, int roomB) {
 }
 
 // Check if connection between two rooms already exists and return int value with determined result.
-// Pre-conditions: Pass room graph matrix (7x7) of room connections and two int values, one for room A and
-// one for roomB.
+// Pre-conditions: Pass room graph of room connections and two int values, one for room A and one for roomB.
 // Post-conditions: If roomA and roomB are already connected, return 1, else return 0.
-int connectionAlreadyExists(int roomGraph[7][7], int roomA, int roomB) {
+int connectionAlreadyExists(struct roomGraph* graph, int roomA, int roomB) {
     int connExists = 0;
 
-    int idxA;
-    int idxB;
-
-    // Loop through room matrix and see if room a and room b have a matching connection already. Set connExists to 1
-    // if true and exit.
-    for (idxA = 0; idxA < 7; idxA++) {
-        for (idxB = 0; idxB < 7; idxB++) {
-            if (roomGraph[roomA][idxA] == roomB && roomGraph[roomA][idxA] != -1 && roomGraph[roomB][idxB] != -1) {
-                if (roomGraph[roomB][idxB] == roomA) {
-                    connExists = 1;
-                    break;
-                }
-            }
+    // Single bit test when bit rows are kept
+    if (graph->roomBits != NULL) {
+        uint64_t word = graph->roomBits[(size_t) roomA * graph->bitWords + roomB / 64];
+        return (int) ((word >> (roomB % 64)) & 1);
+    }
+
+    int* connA = &graph->connections[(size_t) roomA * graph->maxDegree];
+    int idx;
+    // Connections are symmetric, so only roomA's own list needs to be checked
+    for (idx = 0; idx < graph->degrees[roomA]; idx++) {
+        if (connA[idx] == roomB) {
+            connExists = 1;
+            break;
         }
     }
 
     return connExists;
 }
 
-// Connect two rooms together. Adds integer value of roomB to the matrix graph for applicable room position of roomA.
-// Pre-conditions: Pass valid matrix graph of room connections and an int value for each room.
-// Post-conditions: Sets room connection matrix with value indicating a connection from roomA to roomB.
-void connectRoom(int roomGraph[7][7], int roomA, int roomB) {
-    roomGraph[roomA][roomB] = roomB;
+// Checks if roomB can be connected to roomA: it must be a different room, not already connected, and still be able
+// to take another connection.
+// Pre-conditions: Pass room graph and two int values, one for room A and one for room B.
+// Post-conditions: Returns 1 if the connection can be added, else return 0.
+int isValidConnection(struct roomGraph* graph, int roomA, int roomB) {
+    int isValid = 0;
+
+    if (isSameRoom(roomA, roomB) == 0 && canAddConnectionFrom(graph, roomB) == 1
+        && connectionAlreadyExists(graph, roomA, roomB) == 0) {
+        isValid = 1;
+    }
+
+    return isValid;
 }
 
-// Adds a random connection between two randomly selected rooms and sets the connection if valid in room
-// connection matrix.
-// Pre-conditions: Pass valid room connection matrix (7x7) to manipulate connections on.
-// Post-conditions: Room connection matrix will be filled with each room containing 3-6 randomly determined connections.
-void addRandomConnection(int roomGraph[7][7]) {
-    int roomA = -1;
-    int roomB = -1;
+// Connect two rooms together. Adds integer value of roomB to the connection list of roomA.
+// Pre-conditions: Pass valid graph of room connections and an int value for each room. roomA must be able to take
+// another connection.
+// Post-conditions: Adds roomB to roomA's connections and removes roomA from the live sets it no longer belongs to.
+void connectRoom(struct roomGraph* graph, int roomA, int roomB) {
+    graph->connections[(size_t) roomA * graph->maxDegree + graph->degrees[roomA]] = roomB;
+    graph->degrees[roomA]++;
+    if (graph->roomBits != NULL) {
+        graph->roomBits[(size_t) roomA * graph->bitWords + roomB / 64] |= 1ULL << (roomB % 64);
+    }
 
-    while (1) {
-        roomA = rand() % 7;
+    if (graph->degrees[roomA] == graph->minDegree) {
+        removeFromRoomSet(graph->underMinRooms, graph->underMinPos, &graph->underMinCount, roomA);
+    }
+    if (graph->degrees[roomA] == graph->maxDegree) {
+        removeFromRoomSet(graph->openRooms, graph->openPos, &graph->openCount, roomA);
+        if (graph->bitWords == 1) {
+            graph->openMask &= ~(1ULL << roomA);
+        }
+    }
+}
 
-        // Check if you can add a room connection to chosen room, if so exit loop
-        if (canAddConnectionFrom(roomGraph, roomA) == 1) {
+// Disconnect roomB from roomA. Removes integer value of roomB from the connection list of roomA.
+// Pre-conditions: Pass valid graph of room connections and an int value for each room. Rooms must be connected.
+// Post-conditions: Removes roomB from roomA's connections and adds roomA back to the live sets it now belongs to.
+void disconnectRoom(struct roomGraph* graph, int roomA, int roomB) {
+    int* connA = &graph->connections[(size_t) roomA * graph->maxDegree];
+    int idx;
+    // Find roomB and replace it with the last connection of roomA
+    for (idx = 0; idx < graph->degrees[roomA]; idx++) {
+        if (connA[idx] == roomB) {
+            connA[idx] = connA[graph->degrees[roomA] - 1];
             break;
         }
     }
 
-    // Randomly generate room to link to until it is not the same room as room a, a connection doesn't exist already,
-    // and it's possible to add a connection (< 6 connections already).
-    do {
-        roomB = rand() % 7;
+    if (graph->roomBits != NULL) {
+        graph->roomBits[(size_t) roomA * graph->bitWords + roomB / 64] &= ~(1ULL << (roomB % 64));
+    }
+
+    if (graph->degrees[roomA] == graph->maxDegree) {
+        addToRoomSet(graph->openRooms, graph->openPos, &graph->openCount, roomA);
+        if (graph->bitWords == 1) {
+            graph->openMask |= 1ULL << roomA;
+        }
+    }
+    if (graph->degrees[roomA] == graph->minDegree) {
+        addToRoomSet(graph->underMinRooms, graph->underMinPos, &graph->underMinCount, roomA);
+    }
+    graph->degrees[roomA]--;
+}
+
+// Finds a room that can be connected to roomA by picking directly from the set of rooms below the maximum. A few
+// random picks are tried first, then the open set is scanned once from a random offset.
+// Pre-conditions: Pass graph and the room needing a connection.
+// Post-conditions: Returns a valid room to connect to roomA, or -1 if no open room can be connected to it.
+int findOpenRoom(struct roomGraph* graph, int roomA) {
+    // With one word rows the valid rooms are the open rooms that are neither roomA nor connected to it
+    if (graph->bitWords == 1) {
+        uint64_t candidates = graph->openMask & ~graph->roomBits[roomA] & ~(1ULL << roomA);
+        return candidates == 0 ? -1 : pickRandomBit(graph->rng, candidates);
+    }
+
+    int attempt;
+    // Random picks succeed almost always unless the open set is nearly exhausted
+    for (attempt = 0; attempt < CONNECTION_ATTEMPTS; attempt++) {
+        int roomB = graph->openRooms[rngBelow(graph->rng, graph->openCount)];
+        if (isValidConnection(graph, roomA, roomB) == 1) {
+            return roomB;
+        }
+    }
+
+    int offset = rngBelow(graph->rng, graph->openCount);
+    int idx;
+    // Scan the open set once, which is small whenever the random picks fail
+    for (idx = 0; idx < graph->openCount; idx++) {
+        int roomB = graph->openRooms[(offset + idx) % graph->openCount];
+        if (isValidConnection(graph, roomA, roomB) == 1) {
+            return roomB;
+        }
+    }
+
+    return -1;
+}
+
+// Gives roomA a connection when every room below the maximum is already roomA or connected to it. A full room X that
+// is not connected to roomA gives up one of its connections (to room Y) and is connected to roomA instead, so X stays
+// at the maximum and only Y loses a connection. Y is picked among rooms above the minimum where possible.
+// Pre-conditions: Pass graph and a room under the minimum for which findOpenRoom found nothing.
+// Post-conditions: roomA has one more connection and one neighbour of X has one less.
+void rewireConnection(struct roomGraph* graph, int roomA) {
+    int roomX = -1;
+
+    // With one word rows the rooms not connected to roomA are found directly
+    if (graph->bitWords == 1) {
+        uint64_t allRooms = graph->roomCount == 64 ? ~0ULL : (1ULL << graph->roomCount) - 1;
+        roomX = pickRandomBit(graph->rng, allRooms & ~graph->roomBits[roomA] & ~(1ULL << roomA));
+    }
+
+    int attempt;
+    // Most rooms are full and unconnected to roomA at this point, so random picks find one quickly
+    for (attempt = 0; attempt < CONNECTION_ATTEMPTS && roomX == -1; attempt++) {
+        int room = rngBelow(graph->rng, graph->roomCount);
+        if (isSameRoom(roomA, room) == 0 && connectionAlreadyExists(graph, roomA, room) == 0) {
+            roomX = room;
+        }
+    }
+
+    int room;
+    // roomA has fewer connections than there are other rooms, so the scan always finds one
+    for (room = 0; room < graph->roomCount && roomX == -1; room++) {
+        if (isSameRoom(roomA, room) == 0 && connectionAlreadyExists(graph, roomA, room) == 0) {
+            roomX = room;
+        }
+    }
+
+    int* connX = &graph->connections[(size_t) roomX * graph->maxDegree];
+    int roomY = -1;
+    int idx;
+    // Pick a neighbour of X not connected to roomA, preferring one that stays at or above the minimum
+    for (idx = 0; idx < graph->degrees[roomX]; idx++) {
+        int candidate = connX[idx];
+        if (isSameRoom(roomA, candidate) == 1 || connectionAlreadyExists(graph, roomA, candidate) == 1) {
+            continue;
+        }
+        if (roomY == -1 || graph->degrees[candidate] > graph->minDegree) {
+            roomY = candidate;
+        }
+        if (graph->degrees[candidate] > graph->minDegree) {
+            break;
+        }
+    }
+
+    disconnectRoom(graph, roomX, roomY);
+    disconnectRoom(graph, roomY, roomX);
+    connectRoom(graph, roomA, roomX);
+    connectRoom(graph, roomX, roomA);
+}
+
+// Adds a connection for a random room that is still under the minimum. The other end is picked directly from the
+// rooms that are still below the maximum, so no time is spent drawing rooms that can't take a connection.
+// Pre-conditions: Pass valid room connection graph that is not yet full.
+// Post-conditions: One room under the minimum gains a connection. Returns 0 if the rewire limit was reached and
+// the requested degrees can't be satisfied, otherwise 1.
+int addRandomConnection(struct roomGraph* graph, int* rewiresLeft) {
+    int roomA = graph->underMinRooms[rngBelow(graph->rng, graph->underMinCount)];
+    int roomB = findOpenRoom(graph, roomA);
+
+    if (roomB != -1) {
+        connectRoom(graph, roomA, roomB);
+        connectRoom(graph, roomB, roomA);
+        return 1;
+    }
+
+    // Only possible when the open rooms are all connected to roomA already
+    if (*rewiresLeft == 0) {
+        return 0;
+    }
+    (*rewiresLeft)--;
+    rewireConnection(graph, roomA);
+
+    return 1;
+}
+
+// Generates all room connections so that every room ends up with minDegree to maxDegree connections. Each step either
+// adds one connection or rewires one, and rewires are limited to a multiple of the room count, so generation is
+// linear in the number of connections and always terminates.
+// Pre-conditions: Pass graph set up with initializeGraph.
+// Post-conditions: Returns 1 if the graph is full, or 0 if the degrees requested can't be satisfied.
+int generateConnections(struct roomGraph* graph) {
+    int rewiresLeft = graph->roomCount * REWIRE_LIMIT_PER_ROOM;
+
+    // Keep adding connections until no room is under the minimum
+    while (isGraphFull(graph) == 0) {
+        if (addRandomConnection(graph, &rewiresLeft) == 0) {
+            return 0;
+        }
     }
-    while(canAddConnectionFrom(roomGraph, roomB) == 0 || isSameRoom(roomA, roomB) == 1
-        || connectionAlreadyExists(roomGraph, roomA, roomB) == 1);
 
-    connectRoom(roomGraph, roomA, roomB);
-    connectRoom(roomGraph, roomB, roomA);
+    return 1;
 }
 
-// Randomly selects 7 out of 10 possible room names to be used.
-// Pre-conditions: Must be passed a char pointer to array of selected rooms.
-// Post-conditions: Selected rooms char* array will be filled with names of 7 randomly selected room names out
-// of 10 possible selections.
-void selectRooms(char* selectedRooms[]) {
-    int chosenRooms[7] = { -1, -1, -1, -1, -1, -1, -1 };
+// Randomly selects roomCount out of 10 possible room names to be used. Worlds with more rooms than there are
+// preset names get generated names of the form Room<number> instead.
+// Pre-conditions: Must be passed a char pointer array with roomCount entries, the number of rooms and the random
+// generator to draw from. nameStorage must hold ROOM_NAME_SIZE chars per room when roomCount is larger than the
+// preset list.
+// Post-conditions: Selected rooms char* array will be filled with names of roomCount randomly selected room names out
+// of 10 possible selections, or with generated names for larger worlds.
+void selectRooms(char* selectedRooms[], int roomCount, char* nameStorage, struct rngState* rng) {
+    int chosenRooms[10] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
 
     // Declare list of possible rooms
     char* rooms[10] = {
@@ -177,18 +551,27 @@ void selectRooms(char* selectedRooms[]) {
     };
 
     int selectedRoom = 0;
-    // Randomly select 7 rooms and add to selected rooms list
-    srand(time(NULL));
-    int i = 0;
-    for (i; i < 7; i++) {
+    // Randomly select rooms and add to selected rooms list
+    int i;
+
+    // Not enough preset names, so number the rooms instead
+    if (roomCount > 10) {
+        for (i = 0; i < roomCount; i++) {
+            selectedRooms[i] = &nameStorage[(size_t) i * ROOM_NAME_SIZE];
+            sprintf(selectedRooms[i], "Room%d", i);
+        }
+        return;
+    }
+
+    for (i = 0; i < roomCount; i++) {
         int uniqueRoom = 0;
         // See if randomly generated value is unique and if not, generate until it is
         while (uniqueRoom == 0) {
             uniqueRoom = 1;
-            selectedRoom = rand() % 10;
+            selectedRoom = rngBelow(rng, 10);
 
-            int x = 0;
-            for (x; x < 7; x++) {
+            int x;
+            for (x = 0; x < roomCount; x++) {
                 if (chosenRooms[x] == selectedRoom) {
                     uniqueRoom = 0;
                 }
@@ -204,127 +587,484 @@ void selectRooms(char* selectedRooms[]) {
 
 }
 
+// Randomly selects which room is the start room and which is the end room. All other rooms are mid rooms.
+// Pre-conditions: Pass random generator, number of rooms (at least 2) and pointers to hold the selected start and end
+// rooms.
+// Post-conditions: startRoom and endRoom are set to two different random rooms.
+void selectRoomTypes(struct rngState* rng, int roomCount, int* startRoom, int* endRoom) {
+    *startRoom = rngBelow(rng, roomCount);
+
+    // Generate until end room is different from start room
+    do {
+        *endRoom = rngBelow(rng, roomCount);
+    }
+    while (isSameRoom(*startRoom, *endRoom) == 1);
+}
+
 // Sets up and creates room files with randomly generated room connections, randomly generated types, and the
-// name of the room in each file.
-// Pre-conditions: Pass valid matrix graph of room connections to generate, name of directory created, and room names
+// name of the room in each file. Each file is rendered into a buffer first and written with a single write call,
+// and files are created relative to the open world directory to avoid resolving the full path every time.
+// Pre-conditions: Pass valid graph of room connections to generate, name of directory created, and room names
 // that are randomly selected to be generated.
 // Post-conditions: Creates a file with applicable name, room connections, and room type for each room in selectedRooms
-// array in the provided directory name location.
-void setupRoomFiles(char dirName[], char* selectedRooms[], int roomGraph[7][7]) {
+// array in the provided directory name location. Returns 1 on success or 0 if any file could not be written.
+int setupRoomFiles(char dirName[], char* selectedRooms[], struct roomGraph* graph) {
+    int startRoom;
+    int endRoom;
+    selectRoomTypes(graph->rng, graph->roomCount, &startRoom, &endRoom);
+
+    int dirFd = open(dirName, O_RDONLY | O_DIRECTORY);
+    if (dirFd < 0) {
+        perror("Error opening directory.");
+        return 0;
+    }
 
-    int roomTypes[7] = { -1, -1, -1, -1, -1, -1, -1 };
-    char roomType[25];
-    memset(roomType, '\0', sizeof(roomType));
+    // Largest file has a line per connection, each holding a room name shorter than ROOM_NAME_SIZE
+    size_t bufferSize = (size_t) (graph->maxDegree + 2) * (ROOM_NAME_SIZE + 32);
+    char* fileOutput = malloc(bufferSize);
+    if (fileOutput == NULL) {
+        perror("Error allocating room file buffer");
+        exit(1);
+    }
 
-    int fileNum = 0;
+    int success = 1;
+    int fileNum;
     // Setup room files with name and type
-    for (fileNum; fileNum < 7; fileNum++) {
-        char pathName[50];
-        memset(pathName, 0, 50);
+    for (fileNum = 0; fileNum < graph->roomCount; fileNum++) {
+        char fileName[ROOM_NAME_SIZE + 8];
+        sprintf(fileName, "%s_room", selectedRooms[fileNum]);
+
+        // Output name of room to buffer
+        int length = sprintf(fileOutput, "ROOM NAME: %s\n", selectedRooms[fileNum]);
+
+        int* connections = &graph->connections[(size_t) fileNum * graph->maxDegree];
+        int connection;
+        // Output room connection strings to buffer, numbered from 1
+        for (connection = 0; connection < graph->degrees[fileNum]; connection++) {
+            length += sprintf(&fileOutput[length], "CONNECTION %d: %s\n", connection + 1,
+                              selectedRooms[connections[connection]]);
+        }
 
-        // Create path name for file creation
-        strcat(pathName, dirName);
-        strcat(pathName, "/");
-        strcat(pathName, selectedRooms[fileNum]);
-        strcat(pathName, "_room");
+        // Output room type to buffer. There can only be one start and one end room, all others are mid rooms.
+        if (fileNum == startRoom) {
+            length += sprintf(&fileOutput[length], "ROOM TYPE: START_ROOM\n");
+        }
+        else if (fileNum == endRoom) {
+            length += sprintf(&fileOutput[length], "ROOM TYPE: END_ROOM\n");
+        }
+        else {
+            length += sprintf(&fileOutput[length], "ROOM TYPE: MID_ROOM\n");
+        }
 
-        FILE * fPointer = fopen(pathName, "w");
+        int fileFd = openat(dirFd, fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
-        // Check to see if file was opened
-        if (fPointer == NULL) {
+        // Check to see if file was opened, then write and close it
+        if (fileFd < 0) {
             perror("Error opening a file.");
+            success = 0;
+            continue;
         }
-            // Output room name and room type to file
-        else {
-            char fileOutput[25];
-            memset(fileOutput, '\0', sizeof(fileOutput));
-
-            // Output name of room to file
-            strcat(fileOutput, "ROOM NAME: ");
-            strcat(fileOutput, selectedRooms[fileNum]);
-            strcat(fileOutput, "\n");
-            fprintf(fPointer, fileOutput);
-
-            memset(roomType, 0, 25);
-
-            // Randomly select one of the room types. Only 0 can be START and 6 is END
-            int uniqueRoom = 0;
-            // See if randomly generated value is unique and generate until it is
-            while (uniqueRoom == 0) {
-                uniqueRoom = 1;
-                int selectedRoom = rand() % 7;
-
-                int x = 0;
-
-                for (x; x < 7; x++) {
-                    if (roomTypes[x] == selectedRoom) {
-                        uniqueRoom = 0;
-                    }
-                }
-                roomTypes[fileNum] = selectedRoom;
-            }
+        if (write(fileFd, fileOutput, length) != length) {
+            perror("Error writing a file.");
+            success = 0;
+        }
+        close(fileFd);
+    }
 
-            int connection = 0;
-            int connCounter = 0;
-            char connectionChar[2];
-            // Output room connection strings to file
-            for (connection; connection < 7; connection++) {
-                if (roomGraph[fileNum][connection] != -1) {
-                    connCounter++;
+    free(fileOutput);
+    close(dirFd);
 
-                    memset(fileOutput, '\0', sizeof(fileOutput));
-                    strcat(fileOutput, "CONNECTION ");
+    return success;
+}
 
-                    // Set connection number after string conversion
-                    sprintf(connectionChar, "%d", connCounter);
-                    strcat(fileOutput, connectionChar);
+// Creates a packed world file (see trompj.world.h) holding the names, types and connections of every room, along
+// with a minimal perfect hash from room name to room id and the shortest path tables adventure answers hints from.
+// The whole file is laid out in one buffer by the packed world writer in trompj.world.h and written with a single
+// open, write and close.
+// Pre-conditions: Pass name of file to create, room names that are randomly selected and the generated graph.
+// Post-conditions: Creates the packed world file. Returns 1 on success or 0 if it could not be written.
+int writePackedWorld(char fileName[], char* selectedRooms[], struct roomGraph* graph) {
+    int startRoom;
+    int endRoom;
+    selectRoomTypes(graph->rng, graph->roomCount, &startRoom, &endRoom);
+
+    uint64_t stringsSize = 0;
+    uint64_t connectionCount = 0;
+    int room;
+    // Size string table and adjacency array
+    for (room = 0; room < graph->roomCount; room++) {
+        stringsSize += strlen(selectedRooms[room]) + 1;
+        connectionCount += graph->degrees[room];
+    }
 
-                    strcat(fileOutput, ": ");
+    uint64_t fileSize;
+    char* fileOutput = worldCreate(graph->roomCount, connectionCount, stringsSize, 0, &fileSize);
+    struct packedHeader* header = (struct packedHeader*) fileOutput;
+
+    char* strings = fileOutput + worldFindSection(header, WORLD_SECTION_STRINGS)->offset;
+    struct packedRoom* rooms =
+            (struct packedRoom*) (fileOutput + worldFindSection(header, WORLD_SECTION_ROOMS)->offset);
+    uint32_t* adjacency = (uint32_t*) (fileOutput + worldFindSection(header, WORLD_SECTION_ADJACENCY)->offset);
+    uint32_t nameOffset = 0;
+    uint32_t firstConnection = 0;
+    // Fill room records, names and connections
+    for (room = 0; room < graph->roomCount; room++) {
+        size_t nameLength = strlen(selectedRooms[room]);
+        memcpy(&strings[nameOffset], selectedRooms[room], nameLength + 1);
+
+        rooms[room].nameOffset = nameOffset;
+        rooms[room].nameLength = (uint8_t) nameLength;
+        rooms[room].firstConnection = firstConnection;
+        rooms[room].connectionCount = (uint16_t) graph->degrees[room];
+        rooms[room].type = ROOM_TYPE_MID;
+        if (room == startRoom) {
+            rooms[room].type = ROOM_TYPE_START;
+        }
+        else if (room == endRoom) {
+            rooms[room].type = ROOM_TYPE_END;
+        }
 
-                    // Output name of room to string based on room matrix
-                    strcat(fileOutput, selectedRooms[roomGraph[fileNum][connection]]);
-                    strcat(fileOutput, "\n");
+        int* connections = &graph->connections[(size_t) room * graph->maxDegree];
+        int connection;
+        for (connection = 0; connection < graph->degrees[room]; connection++) {
+            adjacency[firstConnection + connection] = (uint32_t) connections[connection];
+        }
 
-                    fprintf(fPointer, fileOutput);
-                }
-            }
+        nameOffset += (uint32_t) nameLength + 1;
+        firstConnection += (uint32_t) graph->degrees[room];
+    }
 
-            // Build room type string to add to file. Randomly select whether it is START, END, or MID.
-            // There can only be one of each value, which equals 1 start, 1 end, and 5 mid rooms.
-            strcat(roomType, "ROOM TYPE: ");
-            if (roomTypes[fileNum] == 0) {
-                strcat(roomType, "START_ROOM");
-            }
-            else if (roomTypes[fileNum] == 6) {
-                strcat(roomType, "END_ROOM");
+    // Build the name index and routes over the finished rooms
+    worldFinish(fileOutput);
+
+    int success = 1;
+    if (worldWriteFile(fileName, fileOutput, fileSize) == 0) {
+        perror("Error writing a file.");
+        success = 0;
+    }
+
+    free(fileOutput);
+
+    return success;
+}
+
+// Settings shared by every world built in one run.
+struct worldSettings {
+    int roomCount;
+    int minDegree;
+    int maxDegree;
+    uint64_t seed;
+    int textFormat;
+};
+
+// Reusable state for building worlds one after another: the generator, the graph and room name storage. Each
+// thread of a batch owns one so nothing is shared or reallocated between worlds.
+struct worldBuilder {
+    struct rngState rng;
+    struct roomGraph graph;
+    char** selectedRooms;
+    char* nameStorage;
+};
+
+// Allocates the graph and name storage of a world builder.
+// Pre-conditions: Pass builder struct pointer and valid world settings.
+// Post-conditions: Builder is ready for buildWorld. Exits on allocation failure.
+void initializeBuilder(struct worldBuilder* builder, struct worldSettings* settings) {
+    initializeGraph(&builder->graph, settings->roomCount, settings->minDegree, settings->maxDegree, &builder->rng);
+
+    builder->selectedRooms = malloc(sizeof(char*) * settings->roomCount);
+    builder->nameStorage = NULL;
+    if (settings->roomCount > 10) {
+        builder->nameStorage = malloc((size_t) settings->roomCount * ROOM_NAME_SIZE);
+    }
+    if (builder->selectedRooms == NULL || (settings->roomCount > 10 && builder->nameStorage == NULL)) {
+        perror("Error allocating room names");
+        exit(1);
+    }
+}
+
+// Frees memory held by a world builder.
+// Pre-conditions: Builder was set up with initializeBuilder.
+// Post-conditions: Graph and name storage are freed.
+void freeBuilder(struct worldBuilder* builder) {
+    freeGraph(&builder->graph);
+    free(builder->selectedRooms);
+    free(builder->nameStorage);
+}
+
+// Builds one world: generates its connections from the world's own generator stream and writes it as a packed
+// world file, or as a directory of room files in text format. Stream numbers come from the world number, so a batch
+// gives the same worlds for a given seed no matter how many threads build it.
+// Pre-conditions: Pass initialized builder, world settings, world number and name of world without the packed
+// file suffix.
+// Post-conditions: Returns 1 if the world was written, otherwise 0 with the error reported.
+int buildWorld(struct worldBuilder* builder, struct worldSettings* settings, int worldNum, char dirName[]) {
+    rngSeed(&builder->rng, settings->seed, (uint64_t) worldNum);
+    resetGraph(&builder->graph);
+
+    // Generate all room connections in graph randomly
+    if (generateConnections(&builder->graph) == 0) {
+        fprintf(stderr, "Unable to give every room %d-%d connections\n", settings->minDegree, settings->maxDegree);
+        return 0;
+    }
+
+    // Fill selectedRooms array by randomly selecting rooms to build out of list of 10 options
+    selectRooms(builder->selectedRooms, settings->roomCount, builder->nameStorage, &builder->rng);
+
+    // Packed worlds are a single file
+    if (settings->textFormat == 0) {
+        char fileName[300];
+        sprintf(fileName, "%s%s", dirName, WORLD_FILE_SUFFIX);
+        return writePackedWorld(fileName, builder->selectedRooms, &builder->graph);
+    }
+
+    // Create directory for the room files
+    if (mkdir(dirName, 0755) != 0) {
+        perror("Error creating directory.");
+        return 0;
+    }
+
+    // Generate files with randomly selected room connections, type, and the name of the room
+    return setupRoomFiles(dirName, builder->selectedRooms, &builder->graph);
+}
+
+// Work shared by the threads of a batch. Threads claim worlds in chunks from nextWorld so that they rarely touch
+// the shared counter. newestWorld is the highest world number written, or -1 while none is.
+struct batchJob {
+    struct worldSettings* settings;
+    int worldCount;
+    int nextWorld;
+    int failures;
+    int newestWorld;
+};
+
+// Thread function for batch mode. Claims chunks of world numbers and builds each world as
+// trompj.rooms.<pid>.<world number> until all worlds are claimed.
+// Pre-conditions: Must be passed a batchJob struct pointer.
+// Post-conditions: Claimed worlds are written. Failed worlds are added to the job's failure count and the newest
+// written world is recorded in the job.
+void* batchWorkerThread(void* args) {
+    struct batchJob* job = args;
+    struct worldBuilder builder;
+    initializeBuilder(&builder, job->settings);
+
+    int pid = getpid();
+    int failures = 0;
+    int newestWorld = -1;
+    while (1) {
+        int first = __atomic_fetch_add(&job->nextWorld, BATCH_CHUNK_SIZE, __ATOMIC_RELAXED);
+        if (first >= job->worldCount) {
+            break;
+        }
+
+        int worldNum;
+        // Build every world of the claimed chunk
+        for (worldNum = first; worldNum < first + BATCH_CHUNK_SIZE && worldNum < job->worldCount; worldNum++) {
+            char dirName[64];
+            sprintf(dirName, "trompj.rooms.%d.%d", pid, worldNum);
+
+            if (buildWorld(&builder, job->settings, worldNum, dirName) == 0) {
+                failures++;
             }
             else {
-                strcat(roomType, "MID_ROOM");
+                newestWorld = worldNum;
             }
-            strcat(roomType, "\n");
+        }
+    }
+
+    __atomic_fetch_add(&job->failures, failures, __ATOMIC_RELAXED);
+    // Raise the job's newest world to this thread's if it is newer
+    int seen = __atomic_load_n(&job->newestWorld, __ATOMIC_RELAXED);
+    while (newestWorld > seen
+           && __atomic_compare_exchange_n(&job->newestWorld, &seen, newestWorld, 0, __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED) == 0) {
+    }
+    freeBuilder(&builder);
+
+    return NULL;
+}
 
+// Builds worldCount worlds with a pool of threads and reports how long it took.
+// Pre-conditions: Pass valid world settings, number of worlds, number of threads and int to save the newest world to.
+// Post-conditions: Worlds are written as trompj.rooms.<pid>.<world number>. newestWorld holds the highest world number
+// written, or -1 if none was. Returns number of failed worlds.
+int runBatch(struct worldSettings* settings, int worldCount, int threadCount, int* newestWorld) {
+    struct batchJob job;
+    job.settings = settings;
+    job.worldCount = worldCount;
+    job.nextWorld = 0;
+    job.failures = 0;
+    job.newestWorld = -1;
+
+    pthread_t* threads = malloc(sizeof(pthread_t) * threadCount);
+    if (threads == NULL) {
+        perror("Error allocating threads");
+        exit(1);
+    }
 
+    struct timespec startTime;
+    struct timespec endTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    int i;
+    // Start worker threads and throw error if unable to create
+    for (i = 0; i < threadCount; i++) {
+        if (pthread_create(&threads[i], NULL, &batchWorkerThread, &job) != 0) {
+            perror("Thread was unable to be created.");
+            exit(1);
         }
+    }
+
+    // Wait for every worker to finish
+    for (i = 0; i < threadCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    double seconds = (double) (endTime.tv_sec - startTime.tv_sec) + (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+
+    printf("Built %d worlds with %d threads in %.3f seconds (%.0f worlds/second)\n",
+           worldCount - job.failures, threadCount, seconds, (worldCount - job.failures) / seconds);
+
+    free(threads);
+
+    *newestWorld = job.newestWorld;
+    return job.failures;
+}
+
+// Points the latest world symlink at a world. The link is created under a temporary name and renamed over the old
+// one, so readers always see either the previous or the new world.
+// Pre-conditions: Pass name of the world file or directory in the current directory.
+// Post-conditions: WORLD_LATEST_LINK points at the world. Returns 1 on success, otherwise 0 with error output.
+int updateLatestWorld(char worldName[]) {
+    char tempName[64];
+    sprintf(tempName, "%s.%d.tmp", WORLD_LATEST_LINK, getpid());
+
+    // Clear a link left behind by an earlier failed run with the same pid
+    unlink(tempName);
+    if (symlink(worldName, tempName) != 0) {
+        perror("Error creating latest world link");
+        return 0;
+    }
 
-        // Print to file and close file
-        fprintf(fPointer, roomType);
-        fclose(fPointer);
+    if (rename(tempName, WORLD_LATEST_LINK) != 0) {
+        perror("Error replacing latest world link");
+        unlink(tempName);
+        return 0;
     }
 
+    return 1;
+}
+
+// Parses a positive integer command line value for the given option. Exits with a usage error if invalid.
+// Pre-conditions: Pass option name for error output and string value to parse.
+// Post-conditions: Returns parsed integer value.
+int parseCountArg(char* option, char* value) {
+    char* end = NULL;
+    long parsed = strtol(value, &end, 10);
 
+    if (end == value || *end != '\0' || parsed < 1 || parsed > 100000000) {
+        fprintf(stderr, "Invalid value for %s: %s\n", option, value);
+        exit(1);
+    }
+
+    return (int) parsed;
 }
 
-// Main function creates/opens directory and creates/opens a file for each room. Each room file will be filled with
-// applicable information about the room, such as its name, 3-6 randomly generated room connections, and a randomly
-// generated room type of either start, mid, or end.
-int main() {
-    int roomGraph[7][7];
-    // Initialize matrix of room connections with -1 values
-    initializeGraph(roomGraph);
+// Parses an unsigned 64 bit seed command line value. Exits with a usage error if invalid.
+// Pre-conditions: Pass option name for error output and string value to parse.
+// Post-conditions: Returns parsed seed value.
+uint64_t parseSeedArg(char* option, char* value) {
+    char* end = NULL;
+    unsigned long long parsed = strtoull(value, &end, 0);
 
-    // Generate all room connections in graph randomly
-    while (isGraphFull(roomGraph) == 0) {
-        addRandomConnection(roomGraph);
+    if (end == value || *end != '\0' || value[0] == '-') {
+        fprintf(stderr, "Invalid value for %s: %s\n", option, value);
+        exit(1);
+    }
+
+    return (uint64_t) parsed;
+}
+
+// Main function creates a packed world file, or with --text a directory holding a file for each room. Either holds
+// applicable information about each room, such as its name, randomly generated room connections, and a randomly
+// generated room type of either start, mid, or end. By default 7 rooms with 3-6 connections are built, which can be
+// changed with --rooms, --min-degree and --max-degree. --seed makes the generated world reproducible. --batch builds
+// many worlds in one run, spread over --threads threads (all online cores by default).
+int main(int argc, char* argv[]) {
+    struct worldSettings settings;
+    settings.roomCount = 7;
+    settings.minDegree = 3;
+    settings.maxDegree = 6;
+    settings.seed = defaultSeed();
+    settings.textFormat = 0;
+
+    int worldCount = 0;
+    int threadCount = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+
+    int arg;
+    // Read world size options
+    for (arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "--rooms") == 0 && arg + 1 < argc) {
+            settings.roomCount = parseCountArg(argv[arg], argv[arg + 1]);
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--min-degree") == 0 && arg + 1 < argc) {
+            settings.minDegree = parseCountArg(argv[arg], argv[arg + 1]);
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--max-degree") == 0 && arg + 1 < argc) {
+            settings.maxDegree = parseCountArg(argv[arg], argv[arg + 1]);
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc) {
+            settings.seed = parseSeedArg(argv[arg], argv[arg + 1]);
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--batch") == 0 && arg + 1 < argc) {
+            worldCount = parseCountArg(argv[arg], argv[arg + 1]);
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc) {
+            threadCount = parseCountArg(argv[arg], argv[arg + 1]);
+            arg++;
+        }
+        else if (strcmp(argv[arg], "--text") == 0) {
+            settings.textFormat = 1;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--rooms N] [--min-degree N] [--max-degree N] [--seed N] "
+                            "[--batch N] [--threads N] [--text]\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    // Every room needs enough other rooms to connect to and at least a start and an end room must exist. Packed rooms
+    // store their number of connections in 16 bits.
+    if (settings.roomCount < 2 || settings.minDegree > settings.maxDegree
+        || settings.maxDegree > settings.roomCount - 1 || settings.maxDegree > UINT16_MAX) {
+        fprintf(stderr, "Invalid world size: %d rooms with %d-%d connections\n", settings.roomCount,
+                settings.minDegree, settings.maxDegree);
+        exit(1);
+    }
+
+    // Batch mode builds worlds across a pool of threads, the highest world number written being the newest
+    if (worldCount > 0) {
+        int newestWorld;
+        int failures = runBatch(&settings, worldCount, threadCount, &newestWorld);
+
+        // Leave the link alone if no world was written
+        if (newestWorld >= 0) {
+            char worldName[300];
+            sprintf(worldName, "trompj.rooms.%d.%d%s", getpid(), newestWorld,
+                    settings.textFormat == 0 ? WORLD_FILE_SUFFIX : "");
+            updateLatestWorld(worldName);
+        }
+
+        return failures == 0 ? 0 : 1;
     }
 
     char dir[32] = "trompj.rooms.";
@@ -338,18 +1078,21 @@ int main() {
     strcat(dirName, dir);
     strcat(dirName, pid);
 
-    // Create directory with process ID
-    int result = mkdir(dirName, 0755);
-    if (result != 0) {
-        perror("Error creating directory.");
-    }
+    struct worldBuilder builder;
+    initializeBuilder(&builder, &settings);
 
-    char* selectedRooms[7] = { "", "", "", "", "", "", "" };
-    // Fill selectedRooms and chosenRooms arrays by randomly selecting rooms to build out of list of 10 options
-    selectRooms(selectedRooms);
+    // Build the single world from the first stream of the seed
+    int result = buildWorld(&builder, &settings, 0, dirName);
 
-    // Generate files with randomly selected room connections, type, and the name of the room
-    setupRoomFiles(dirName, selectedRooms, roomGraph);
+    freeBuilder(&builder);
+
+    // Let adventure find the new world without scanning the directory
+    if (result == 1) {
+        if (settings.textFormat == 0) {
+            strcat(dirName, WORLD_FILE_SUFFIX);
+        }
+        updateLatestWorld(dirName);
+    }
 
-    return 0;
-}
\ No newline at end of file
+    return result == 1 ? 0 : 1;
+}
@@ -0,0 +1,1632 @@
+// Author: Justin Tromp
+// Date: 04/25/2020
+// Description: libadventure, the world loading and move logic of adventure as a library. See
+// trompj.libadventure.h for the interface and how to build it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <zconf.h>
+#include <memory.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include "trompj.libadventure.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Size of the buffer directory entries are read into by getdents64, enough for thousands of entries per call
+#define SCAN_BUFFER_SIZE (1 << 20)
+
+// Size of the blocks arenas allocate from the system
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// Struct for a room file of a text world as read by readFile: room name, room type, and an array of the names of
+// connected rooms, all allocated from the arena of the parse.
+struct roomFile {
+    char* roomName;
+    char* roomType;
+    char** roomConnections;
+    int connectionCount;
+};
+
+// Directory entry as returned by the getdents64 system call.
+struct linuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Struct for reading a directory straight from the kernel in large batches of entries, without the per-entry
+// bookkeeping of readdir.
+struct dirScanner {
+    int fd;
+    char* buffer;
+    long length;
+    long position;
+};
+
+// Opens a directory for scanning.
+// Pre-conditions: Pass scanner to initialize and path of directory.
+// Post-conditions: Returns 1 with scanner ready to read the first entry, otherwise 0 with error output.
+static int openDirScanner(struct dirScanner* scanner, const char* path) {
+    scanner->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (scanner->fd == -1) {
+        perror("Could not open directory");
+        return 0;
+    }
+
+    scanner->buffer = malloc(SCAN_BUFFER_SIZE);
+    if (scanner->buffer == NULL) {
+        perror("Error allocating directory buffer");
+        exit(1);
+    }
+    scanner->length = 0;
+    scanner->position = 0;
+
+    return 1;
+}
+
+// Returns the next entry of a directory, reading the next batch of entries when the buffer is used up.
+// Pre-conditions: Pass opened scanner.
+// Post-conditions: Returns the next entry, valid until the following call, or NULL once all entries are read.
+static const struct linuxDirent64* nextDirEntry(struct dirScanner* scanner) {
+    if (scanner->position >= scanner->length) {
+        scanner->length = syscall(SYS_getdents64, scanner->fd, scanner->buffer, SCAN_BUFFER_SIZE);
+        scanner->position = 0;
+
+        if (scanner->length <= 0) {
+            if (scanner->length < 0) {
+                perror("Error reading directory");
+            }
+            scanner->length = 0;
+            return NULL;
+        }
+    }
+
+    const struct linuxDirent64* entry = (const struct linuxDirent64*) (scanner->buffer + scanner->position);
+    scanner->position += entry->d_reclen;
+
+    return entry;
+}
+
+// Closes a directory scanner.
+// Pre-conditions: Pass opened scanner.
+// Post-conditions: Directory is closed and buffer freed.
+static void closeDirScanner(struct dirScanner* scanner) {
+    close(scanner->fd);
+    free(scanner->buffer);
+    scanner->buffer = NULL;
+}
+
+// Parses the pid and world number out of a world name of the form trompj.rooms.<pid>[.<world number>][.world].
+// Pre-conditions: Pass NUL terminated name and pointers to hold pid and world number.
+// Post-conditions: Returns 1 with pid and world number (-1 for single worlds) set if name is a world name,
+// otherwise 0.
+static int parseWorldName(const char* name, long* pid, long* worldNum) {
+    if (strncmp(name, WORLD_NAME_PREFIX, sizeof(WORLD_NAME_PREFIX) - 1) != 0) {
+        return 0;
+    }
+
+    const char* cursor = name + sizeof(WORLD_NAME_PREFIX) - 1;
+    if (*cursor < '0' || *cursor > '9') {
+        return 0;
+    }
+
+    char* end = NULL;
+    *pid = strtol(cursor, &end, 10);
+    *worldNum = -1;
+
+    // Batch worlds carry a world number after the pid
+    if (end[0] == '.' && end[1] >= '0' && end[1] <= '9') {
+        *worldNum = strtol(end + 1, &end, 10);
+    }
+
+    return *end == '\0' || strcmp(end, WORLD_FILE_SUFFIX) == 0;
+}
+
+// Finds the newest world in a directory from the names of its entries alone. Entries are filtered by type and
+// prefix before anything else is done with them, and recency is decided by the pid and world number in the name,
+// so no entry is ever stat'ed. Pids only grow until they wrap around at the system's pid limit, so this orders
+// worlds by creation except across a wrap.
+// Pre-conditions: Pass path of directory and char array to save world name to.
+// Post-conditions: Newest world name is saved to dirName, or dirName is empty if there is none.
+void scanNewestWorld(const char* path, char dirName[128]) {
+    long newestPid = -1;
+    long newestWorldNum = -1;
+    memset(dirName, '\0', 128);
+
+    struct dirScanner scanner;
+    if (openDirScanner(&scanner, path) == 0) {
+        return;
+    }
+
+    const struct linuxDirent64* entry;
+    // Loop through directory contents
+    while ((entry = nextDirEntry(&scanner)) != NULL) {
+        // Worlds are directories or packed world files. File systems that don't report types give DT_UNKNOWN.
+        if (entry->d_type != DT_DIR && entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN) {
+            continue;
+        }
+
+        long pid;
+        long worldNum;
+        if (parseWorldName(entry->d_name, &pid, &worldNum) == 0 || strlen(entry->d_name) > 127) {
+            continue;
+        }
+
+        // Keep the world if it came from a later run, or later in the same batch run
+        if (pid > newestPid || (pid == newestPid && worldNum > newestWorldNum)) {
+            newestPid = pid;
+            newestWorldNum = worldNum;
+            strcpy(dirName, entry->d_name);
+        }
+    }
+
+    closeDirScanner(&scanner);
+}
+
+// Checks all directories in current location and determines the most recent rooms directory.
+// The name of the directory is saved in parameter variable for later use. The latest world link kept by buildrooms
+// is used when it points at an existing world; the directory is only scanned when it doesn't.
+// Pre-conditions: Char array parameter to save directory name to.
+// Post-conditions: Most recent directory name is saved to dirName char array.
+void mostRecentRooms(char dirName[128]) {
+    memset(dirName, '\0', 128);
+
+    // Resolve the latest world link, falling back to a scan if it is missing or dangling
+    ssize_t linkLength = readlink(WORLD_LATEST_LINK, dirName, 127);
+    if (linkLength > 0 && access(dirName, F_OK) == 0) {
+        return;
+    }
+
+    scanNewestWorld(".", dirName);
+}
+
+// Struct for one block of an arena. Allocations are carved from the bytes after the block header.
+struct arenaBlock {
+    struct arenaBlock* next;
+    size_t size;
+    size_t used;
+};
+
+// Struct for an arena: a list of blocks that allocations are bumped out of and that are all freed together. Data
+// that lives and dies with a world or a parse goes into one arena, so it is laid out in the order it was made and
+// released with one call instead of a free per string.
+struct arena {
+    struct arenaBlock* blocks;
+};
+
+// Allocates memory from an arena, aligned for any of the world's types. Allocations larger than a quarter block get
+// a block of their own, placed behind the current block so it keeps filling with small allocations.
+// Pre-conditions: Pass initialized arena and number of bytes.
+// Post-conditions: Returns memory that stays valid until the arena is freed. Exits if it can't be allocated.
+static void* arenaAlloc(struct arena* arena, size_t size) {
+    size = (size + 7) & ~(size_t) 7;
+    struct arenaBlock* block = arena->blocks;
+
+    if (block == NULL || block->size - block->used < size) {
+        size_t blockSize = size > ARENA_BLOCK_SIZE / 4 ? size : ARENA_BLOCK_SIZE;
+        struct arenaBlock* newBlock = malloc(sizeof(struct arenaBlock) + blockSize);
+        if (newBlock == NULL) {
+            perror("Error allocating arena");
+            exit(1);
+        }
+        newBlock->size = blockSize;
+        newBlock->used = 0;
+
+        if (block != NULL && blockSize != ARENA_BLOCK_SIZE) {
+            newBlock->next = block->next;
+            block->next = newBlock;
+        }
+        else {
+            newBlock->next = block;
+            arena->blocks = newBlock;
+        }
+        block = newBlock;
+    }
+
+    void* memory = (char*) (block + 1) + block->used;
+    block->used += size;
+
+    return memory;
+}
+
+// Frees every block of an arena.
+// Pre-conditions: Pass initialized arena.
+// Post-conditions: All memory allocated from the arena is freed and the arena is empty.
+static void freeArena(struct arena* arena) {
+    while (arena->blocks != NULL) {
+        struct arenaBlock* next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+}
+
+// Allocates memory that lives as long as a world, creating the world's arena on first use. Packed worlds that carry
+// everything they need never allocate.
+// Pre-conditions: Pass world and number of bytes.
+// Post-conditions: Returns memory that is freed by freeWorld.
+static void* worldAlloc(struct world* world, size_t size) {
+    if (world->arena == NULL) {
+        world->arena = calloc(1, sizeof(struct arena));
+        if (world->arena == NULL) {
+            perror("Error allocating arena");
+            exit(1);
+        }
+    }
+
+    return arenaAlloc(world->arena, size);
+}
+
+// Takes a room file struct pointer as parameter and sets all values to NULL to initialize.
+// Pre-conditions: Room file struct pointer passed to be initialized.
+// Post-conditions: All aspects of the room file struct are set to NULL.
+static void initializeData(struct roomFile* roomObj) {
+    // Initialize struct values before assignment
+    roomObj->roomName = NULL;
+
+    roomObj->roomType = NULL;
+
+    roomObj->roomConnections = NULL;
+    roomObj->connectionCount = 0;
+}
+
+// Copies the value of a room file line, the text after the ": " that ends its label up to the newline, into an
+// arena. Labels such as "CONNECTION 10:" differ in length, so the value is found by the separator and not a column.
+// Pre-conditions: Pass arena and NUL terminated line.
+// Post-conditions: Returns NUL terminated copy of the value, empty if the line has no separator.
+static char* copyLineValue(struct arena* arena, const char* lineRead) {
+    const char* start = strchr(lineRead, ':');
+    if (start == NULL || start[1] != ' ') {
+        start = "";
+    }
+    else {
+        start += 2;
+    }
+
+    size_t valueLength = strcspn(start, "\n");
+    char* value = arenaAlloc(arena, valueLength + 1);
+    memcpy(value, start, valueLength);
+    value[valueLength] = '\0';
+
+    return value;
+}
+
+// Reads a room file and sets values in a room file struct, such as name, type, and connections. This room
+// file struct is then returned. Its strings and connection array are allocated from the arena, so they are freed
+// with it rather than one by one.
+// Pre-conditions: A FILE pointer is passed as parameter, which will be the file to read room information from, along
+// with the arena of the parse.
+// Post-conditions: A room file struct has all variables set with name, type, and connections for that room and is
+// returned.
+static struct roomFile readFile(FILE* fPointer, struct arena* arena) {
+    char lineRead[256];
+    memset(lineRead, '\0', 256);
+
+    // Declare a room file struct and initialize it to be returned at end of function with data
+    struct roomFile roomObj;
+    initializeData(&roomObj);
+
+    int capacity = 0;
+    // Read line from file
+    while (fgets(lineRead, 255, fPointer) != NULL) {
+        // Check if line is room name and add to struct
+        if (strstr(lineRead, "ROOM NAME:")) {
+            roomObj.roomName = copyLineValue(arena, lineRead);
+        }
+        // Check if line is room type and add to struct
+        else if (strstr(lineRead, "ROOM TYPE:")) {
+            roomObj.roomType = copyLineValue(arena, lineRead);
+        }
+        // Check if line is a connection and add to struct
+        else if (strstr(lineRead, "CONNECTION")) {
+            // Make room for another connection. The old array stays in the arena, which costs at most as much as
+            // the final array since capacity doubles.
+            if (roomObj.connectionCount == capacity) {
+                capacity = capacity == 0 ? 8 : capacity * 2;
+                char** connections = arenaAlloc(arena, sizeof(char*) * capacity);
+                if (roomObj.connectionCount > 0) {
+                    memcpy(connections, roomObj.roomConnections, sizeof(char*) * roomObj.connectionCount);
+                }
+                roomObj.roomConnections = connections;
+            }
+
+            // Set room connection
+            roomObj.roomConnections[roomObj.connectionCount] = copyLineValue(arena, lineRead);
+            roomObj.connectionCount++;
+        }
+        memset(lineRead, '\0', 256);
+    }
+
+    return roomObj;
+}
+
+// Struct for one room held by a paged world's room cache: its record, name and connections as read from the file,
+// and its links in the cache's hash chains and recency list. Name and connections share one buffer, which is kept
+// when the slot is reused for another room and only grows.
+struct cachedRoom {
+    int roomId;
+    struct packedRoom record;
+    char* name;
+    uint32_t* connections;
+    size_t storageSize;
+    int nextInBucket;
+    int newer;
+    int older;
+};
+
+// Struct for the room cache of a paged world. Only the header, name index header and routes header are read when
+// the world is opened. Rooms are read with pread the first time they are needed and kept in a fixed number of
+// slots, evicting the least recently used room once all are taken, so memory is set by capacity and not by the
+// size of the world. Room ids are found in their slot through a chained hash table with a bucket per slot. failed is
+// set once the file can't be read or holds an invalid room, after which every lookup on the world fails.
+struct roomCache {
+    int fd;
+    int failed;
+    struct packedHeader header;
+    uint64_t stringsOffset;
+    uint64_t roomsOffset;
+    uint64_t adjacencyOffset;
+    uint64_t nameIndexOffset;
+    struct packedNameIndex nameIndex;
+    uint64_t routesOffset;
+    struct packedRoutes routes;
+    int capacity;
+    int count;
+    struct cachedRoom* rooms;
+    int* buckets;
+    int newest;
+    int oldest;
+    uint32_t* neighbors;
+    int neighborCapacity;
+};
+
+// Reads bytes of a paged world's file. The file was checked when the world was opened, so a failed read means it
+// changed or vanished under the game, and the cache is marked failed for the caller to find with worldReadFailed.
+// Pre-conditions: Pass room cache, buffer, number of bytes and file offset to read from.
+// Post-conditions: Buffer holds the bytes and 1 is returned, otherwise the cache is failed and 0 is returned.
+static int readWorldBytes(struct roomCache* cache, void* buffer, size_t size, uint64_t offset) {
+    char* cursor = buffer;
+    while (size > 0) {
+        ssize_t bytesRead = pread(cache->fd, cursor, size, (off_t) offset);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            cache->failed = 1;
+            return 0;
+        }
+        cursor += bytesRead;
+        size -= (size_t) bytesRead;
+        offset += (uint64_t) bytesRead;
+    }
+
+    return 1;
+}
+
+// Reads a uint32_t entry of a section of a paged world.
+// Pre-conditions: Pass room cache, offset of the array in the file and index of the entry.
+// Post-conditions: Returns the entry, or WORLD_ROUTE_NONE with the cache failed if it could not be read.
+static uint32_t readWorldEntry(struct roomCache* cache, uint64_t arrayOffset, uint64_t index) {
+    uint32_t entry;
+    if (readWorldBytes(cache, &entry, sizeof(uint32_t), arrayOffset + index * sizeof(uint32_t)) == 0) {
+        return WORLD_ROUTE_NONE;
+    }
+
+    return entry;
+}
+
+// Takes a cached room out of the recency list.
+// Pre-conditions: Pass room cache and slot of a room in the list.
+// Post-conditions: Room is no longer in the recency list.
+static void unlinkCachedRoom(struct roomCache* cache, int slot) {
+    struct cachedRoom* room = &cache->rooms[slot];
+    if (room->newer != -1) {
+        cache->rooms[room->newer].older = room->older;
+    }
+    else {
+        cache->newest = room->older;
+    }
+    if (room->older != -1) {
+        cache->rooms[room->older].newer = room->newer;
+    }
+    else {
+        cache->oldest = room->newer;
+    }
+}
+
+// Puts a cached room at the newest end of the recency list.
+// Pre-conditions: Pass room cache and slot of a room not in the list.
+// Post-conditions: Room is the most recently used room.
+static void markNewest(struct roomCache* cache, int slot) {
+    struct cachedRoom* room = &cache->rooms[slot];
+    room->newer = -1;
+    room->older = cache->newest;
+    if (cache->newest != -1) {
+        cache->rooms[cache->newest].newer = slot;
+    }
+    cache->newest = slot;
+    if (cache->oldest == -1) {
+        cache->oldest = slot;
+    }
+}
+
+// Reads a room of a paged world into a cache slot, checking it the same way worldValidate checks a whole world.
+// Pre-conditions: Pass room cache, free slot and valid room id.
+// Post-conditions: Slot holds the room and 1 is returned, otherwise the cache is failed and 0 is returned.
+static int readCachedRoom(struct roomCache* cache, int slot, int roomId) {
+    struct cachedRoom* room = &cache->rooms[slot];
+    room->roomId = roomId;
+    if (readWorldBytes(cache, &room->record, sizeof(struct packedRoom),
+                       cache->roomsOffset + (uint64_t) roomId * sizeof(struct packedRoom)) == 0
+        || worldValidateRoom(&cache->header, &room->record) == 0) {
+        cache->failed = 1;
+        return 0;
+    }
+
+    // Connections go after the name, aligned for their type
+    size_t nameSize = ((size_t) room->record.nameLength + 1 + 3) & ~(size_t) 3;
+    size_t storageSize = nameSize + sizeof(uint32_t) * room->record.connectionCount;
+    if (storageSize > room->storageSize) {
+        free(room->name);
+        room->name = malloc(storageSize);
+        if (room->name == NULL) {
+            perror("Error allocating cached room");
+            exit(1);
+        }
+        room->storageSize = storageSize;
+    }
+    room->connections = (uint32_t*) (room->name + nameSize);
+
+    if (readWorldBytes(cache, room->name, (size_t) room->record.nameLength + 1,
+                       cache->stringsOffset + room->record.nameOffset) == 0
+        || readWorldBytes(cache, room->connections, sizeof(uint32_t) * room->record.connectionCount,
+                          cache->adjacencyOffset + (uint64_t) room->record.firstConnection * sizeof(uint32_t)) == 0) {
+        return 0;
+    }
+
+    int valid = room->name[room->record.nameLength] == '\0';
+    int conn;
+    for (conn = 0; conn < room->record.connectionCount; conn++) {
+        if (room->connections[conn] >= cache->header.roomCount) {
+            valid = 0;
+        }
+    }
+    if (valid == 0) {
+        cache->failed = 1;
+    }
+
+    return valid;
+}
+
+// Finds a room of a paged world in its room cache, reading it from the file if it isn't cached. The returned room
+// stays cached until capacity - 1 other rooms have been fetched. Once a room could not be read the cache is failed
+// and left as it is, so every later fetch fails too.
+// Pre-conditions: Pass paged world and valid room id.
+// Post-conditions: Returns the cached room, now the most recently used one, or NULL if the cache is failed.
+static const struct cachedRoom* fetchRoom(const struct world* world, int roomId) {
+    struct roomCache* cache = world->roomCache;
+    if (cache->failed == 1) {
+        return NULL;
+    }
+    int* bucket = &cache->buckets[roomId % cache->capacity];
+
+    int slot;
+    // Rooms already cached only move to the newest end of the recency list
+    for (slot = *bucket; slot != -1; slot = cache->rooms[slot].nextInBucket) {
+        if (cache->rooms[slot].roomId == roomId) {
+            if (cache->newest != slot) {
+                unlinkCachedRoom(cache, slot);
+                markNewest(cache, slot);
+            }
+            return &cache->rooms[slot];
+        }
+    }
+
+    // Take a free slot, or evict the least recently used room once all are taken
+    if (cache->count < cache->capacity) {
+        slot = cache->count;
+        cache->count++;
+    }
+    else {
+        slot = cache->oldest;
+        unlinkCachedRoom(cache, slot);
+
+        int* link = &cache->buckets[cache->rooms[slot].roomId % cache->capacity];
+        while (*link != slot) {
+            link = &cache->rooms[*link].nextInBucket;
+        }
+        *link = cache->rooms[slot].nextInBucket;
+    }
+
+    if (readCachedRoom(cache, slot, roomId) == 0) {
+        return NULL;
+    }
+    cache->rooms[slot].nextInBucket = *bucket;
+    *bucket = slot;
+    markNewest(cache, slot);
+
+    return &cache->rooms[slot];
+}
+
+// Looks up a name in a paged world's name index the way worldNameIndexLookup does, reading the two entries it
+// needs from the file.
+// Pre-conditions: Pass room cache and NUL terminated name.
+// Post-conditions: Returns id of the only room the name can belong to, or -1 if the index entry is not valid or
+// could not be read.
+static int lookupPagedName(struct roomCache* cache, const char* name) {
+    const struct packedNameIndex* index = &cache->nameIndex;
+    uint64_t hash = worldHashName(name, index->seed);
+    uint32_t displacement = readWorldEntry(cache, cache->nameIndexOffset + sizeof(struct packedNameIndex),
+                                           worldReduce(hash, index->bucketCount));
+    uint32_t roomId = readWorldEntry(cache, cache->nameIndexOffset + sizeof(struct packedNameIndex),
+                                     (uint64_t) index->bucketCount
+                                     + worldNameSlot(hash, displacement, index->slotCount));
+
+    return roomId < cache->header.roomCount && cache->failed == 0 ? (int) roomId : -1;
+}
+
+// Opens a packed world for paging: only the header and the headers of the name index and routes are read, so the
+// time to open it does not depend on its size. Worlds that are directories, or that lack a name index or routes,
+// are loaded whole with loadWorld instead. A paged world supports sessions, room names and route lookups; its rooms
+// and connections arrays are not set, so solveWorld and session batches need a world loaded with loadWorld.
+// Pre-conditions: Valid path of world, world struct to load into and number of rooms to cache.
+// Post-conditions: World is open with its room cache, or loaded whole. Returns 1 on success, otherwise 0.
+int loadPagedWorld(char worldName[], struct world* world, int cacheRooms) {
+    memset(world, 0, sizeof(struct world));
+
+    struct stat worldAttributes;
+    if (stat(worldName, &worldAttributes) != 0 || S_ISDIR(worldAttributes.st_mode)) {
+        return loadWorld(worldName, world);
+    }
+
+    struct roomCache* cache = calloc(1, sizeof(struct roomCache));
+    if (cache == NULL) {
+        perror("Error allocating room cache");
+        exit(1);
+    }
+    cache->fd = open(worldName, O_RDONLY);
+    if (cache->fd < 0) {
+        perror("Error opening world file");
+        free(cache);
+        return 0;
+    }
+
+    struct packedHeader* header = &cache->header;
+    const struct packedSection* nameIndex = NULL;
+    const struct packedSection* routes = NULL;
+    int usable = fstat(cache->fd, &worldAttributes) == 0
+                 && pread(cache->fd, header, sizeof(struct packedHeader), 0) == sizeof(struct packedHeader)
+                 && worldValidateLayout(header, (uint64_t) worldAttributes.st_size) == 1;
+    if (usable == 1) {
+        nameIndex = worldFindSection(header, WORLD_SECTION_NAME_INDEX);
+        routes = worldFindSection(header, WORLD_SECTION_ROUTES);
+        usable = nameIndex != NULL && routes != NULL && nameIndex->size >= sizeof(struct packedNameIndex)
+                 && routes->size >= sizeof(struct packedRoutes);
+    }
+    if (usable == 1) {
+        usable = readWorldBytes(cache, &cache->nameIndex, sizeof(struct packedNameIndex), nameIndex->offset) == 1
+                 && readWorldBytes(cache, &cache->routes, sizeof(struct packedRoutes), routes->offset) == 1
+                 && worldValidateNameIndex(header, nameIndex, &cache->nameIndex) == 1
+                 && worldValidateRoutes(header, routes, &cache->routes) == 1;
+    }
+
+    // Let loadWorld report what is wrong with the file or build what it lacks
+    if (usable == 0) {
+        close(cache->fd);
+        free(cache);
+        return loadWorld(worldName, world);
+    }
+
+    cache->stringsOffset = worldFindSection(header, WORLD_SECTION_STRINGS)->offset;
+    cache->roomsOffset = worldFindSection(header, WORLD_SECTION_ROOMS)->offset;
+    cache->adjacencyOffset = worldFindSection(header, WORLD_SECTION_ADJACENCY)->offset;
+    cache->nameIndexOffset = nameIndex->offset;
+    cache->routesOffset = routes->offset;
+
+    cache->capacity = cacheRooms < ROOM_CACHE_MIN_ROOMS ? ROOM_CACHE_MIN_ROOMS : cacheRooms;
+    cache->newest = -1;
+    cache->oldest = -1;
+    cache->rooms = calloc((size_t) cache->capacity, sizeof(struct cachedRoom));
+    cache->buckets = malloc(sizeof(int) * cache->capacity);
+    if (cache->rooms == NULL || cache->buckets == NULL) {
+        perror("Error allocating room cache");
+        exit(1);
+    }
+    int bucketNum;
+    for (bucketNum = 0; bucketNum < cache->capacity; bucketNum++) {
+        cache->buckets[bucketNum] = -1;
+    }
+
+    world->roomCount = (int) header->roomCount;
+    world->startRoom = (int) header->startRoom;
+    world->roomCache = cache;
+
+    return 1;
+}
+
+// Frees a paged world's room cache and closes its file.
+// Pre-conditions: Pass room cache.
+// Post-conditions: Room cache memory is freed.
+static void freeRoomCache(struct roomCache* cache) {
+    int slot;
+    for (slot = 0; slot < cache->capacity; slot++) {
+        free(cache->rooms[slot].name);
+    }
+
+    close(cache->fd);
+    free(cache->rooms);
+    free(cache->buckets);
+    free(cache->neighbors);
+    free(cache);
+}
+
+// Returns the name of a room.
+// Pre-conditions: Pass loaded world and valid room id.
+// Post-conditions: Returns pointer to the room's name in the world's string table, or for paged worlds in the room
+// cache, where it stays until the room is evicted. Returns NULL if a paged world could not read the room.
+const char* roomName(const struct world* world, int roomId) {
+    if (world->roomCache != NULL) {
+        const struct cachedRoom* room = fetchRoom(world, roomId);
+        return room != NULL ? room->name : NULL;
+    }
+
+    return &world->names[world->rooms[roomId].nameOffset];
+}
+
+// Builds the world's name index from the names in its string table, for worlds that don't carry one.
+// Pre-conditions: Pass world with rooms and names set.
+// Post-conditions: World has its name index set. Returns 1 on success, otherwise 0 with the error reported.
+static int buildNameIndex(struct world* world) {
+    const char** names = malloc(sizeof(char*) * world->roomCount);
+    char* nameIndex = worldAlloc(world, worldNameIndexSize(world->roomCount));
+    if (names == NULL) {
+        perror("Error allocating name index");
+        exit(1);
+    }
+
+    int roomNum;
+    for (roomNum = 0; roomNum < world->roomCount; roomNum++) {
+        names[roomNum] = roomName(world, roomNum);
+    }
+
+    int success = worldBuildNameIndex(names, world->roomCount, nameIndex);
+    free(names);
+
+    if (success == 0) {
+        fprintf(stderr, "Could not index room names, are they unique?\n");
+        return 0;
+    }
+    world->nameIndex = (const struct packedNameIndex*) nameIndex;
+
+    return 1;
+}
+
+// Builds the shortest path tables of a world that has none stored, the same way buildrooms does for packed worlds.
+// Worlds without an end room have nothing to route to and are left without tables.
+// Pre-conditions: Pass world with its rooms and connections set.
+// Post-conditions: World routes are set unless it has no end room.
+static void buildRoutes(struct world* world) {
+    int endRoom;
+    for (endRoom = 0; endRoom < world->roomCount; endRoom++) {
+        if (world->rooms[endRoom].type == ROOM_TYPE_END) {
+            break;
+        }
+    }
+    if (endRoom == world->roomCount) {
+        return;
+    }
+
+    char* routes = worldAlloc(world, worldRoutesSize(world->roomCount, worldRouteMatrixRooms(world->roomCount)));
+    if (worldBuildRoutes(world->rooms, world->connections, world->roomCount, endRoom, routes) == 0) {
+        perror("Error allocating routes");
+        exit(1);
+    }
+    world->routes = (const struct packedRoutes*) routes;
+}
+
+// Finds a room by name using the world's name index.
+// Pre-conditions: Pass world with name index set and NUL terminated name.
+// Post-conditions: Returns id of the room with that name, or -1 if there is none.
+int findRoomByName(const struct world* world, const char* name) {
+    int roomId;
+    if (world->roomCache != NULL) {
+        roomId = lookupPagedName(world->roomCache, name);
+    }
+    else {
+        roomId = (int) worldNameIndexLookup(world->nameIndex, name);
+    }
+
+    // The index maps every name to some room, so check it is the right one
+    const char* foundName = roomId == -1 ? NULL : roomName(world, roomId);
+    if (foundName == NULL || strcmp(foundName, name) != 0) {
+        return -1;
+    }
+
+    return roomId;
+}
+
+// Interns the rooms of a text world: every name is copied once into the world's string table, room files become
+// packedRoom records, the name index is built, and connection names are resolved to room ids through it in the
+// world's adjacency array. All of it is allocated from the world's arena.
+// Pre-conditions: Pass array of room files read by readFile, number of room files and world to set rooms of.
+// Post-conditions: World has its rooms set. Returns 1 on success, otherwise 0 with the error reported.
+static int internTextRooms(struct roomFile roomFiles[], int roomCount, struct world* world) {
+    size_t namesSize = 0;
+    size_t connectionCount = 0;
+    int roomNum;
+    // Size string table and adjacency array
+    for (roomNum = 0; roomNum < roomCount; roomNum++) {
+        if (roomFiles[roomNum].roomName == NULL || roomFiles[roomNum].roomType == NULL) {
+            fprintf(stderr, "Room file is missing its name or type\n");
+            return 0;
+        }
+        namesSize += strlen(roomFiles[roomNum].roomName) + 1;
+        connectionCount += roomFiles[roomNum].connectionCount;
+    }
+
+    struct packedRoom* rooms = worldAlloc(world, sizeof(struct packedRoom) * roomCount);
+    uint32_t* connections = worldAlloc(world, sizeof(uint32_t) * (connectionCount + 1));
+    char* names = worldAlloc(world, namesSize);
+
+    world->rooms = rooms;
+    world->connections = connections;
+    world->names = names;
+    world->roomCount = roomCount;
+    world->startRoom = -1;
+
+    uint32_t nameOffset = 0;
+    // Copy names into the string table and set room types
+    for (roomNum = 0; roomNum < roomCount; roomNum++) {
+        struct packedRoom* roomObj = &rooms[roomNum];
+        size_t nameLength = strlen(roomFiles[roomNum].roomName);
+        memcpy(&names[nameOffset], roomFiles[roomNum].roomName, nameLength + 1);
+
+        roomObj->nameOffset = nameOffset;
+        roomObj->nameLength = (uint8_t) nameLength;
+        roomObj->type = ROOM_TYPE_MID;
+        if (strcmp(roomFiles[roomNum].roomType, "START_ROOM") == 0) {
+            roomObj->type = ROOM_TYPE_START;
+            world->startRoom = roomNum;
+        }
+        else if (strcmp(roomFiles[roomNum].roomType, "END_ROOM") == 0) {
+            roomObj->type = ROOM_TYPE_END;
+        }
+
+        nameOffset += (uint32_t) nameLength + 1;
+    }
+
+    if (buildNameIndex(world) == 0) {
+        return 0;
+    }
+
+    int success = 1;
+    uint32_t firstConnection = 0;
+    // Resolve connection names to room ids, stopping at the first unknown one
+    for (roomNum = 0; roomNum < roomCount && success == 1; roomNum++) {
+        struct packedRoom* roomObj = &rooms[roomNum];
+        roomObj->firstConnection = firstConnection;
+        roomObj->connectionCount = (uint16_t) roomFiles[roomNum].connectionCount;
+
+        int conn;
+        for (conn = 0; conn < roomFiles[roomNum].connectionCount; conn++) {
+            int connRoom = findRoomByName(world, roomFiles[roomNum].roomConnections[conn]);
+
+            if (connRoom == -1) {
+                fprintf(stderr, "Room %s connects to unknown room %s\n", roomFiles[roomNum].roomName,
+                        roomFiles[roomNum].roomConnections[conn]);
+                success = 0;
+                break;
+            }
+            connections[firstConnection + conn] = (uint32_t) connRoom;
+        }
+
+        firstConnection += roomObj->connectionCount;
+    }
+
+    if (success == 1 && world->startRoom == -1) {
+        fprintf(stderr, "World has no start room\n");
+        success = 0;
+    }
+
+    if (success == 1) {
+        buildRoutes(world);
+    }
+
+    return success;
+}
+
+// Open directory and read room file contents. Room information is read into room file structs and then interned
+// into the world's rooms for later use. The room files' strings are only needed until then, so they share one
+// arena that is freed in one call.
+// Pre-conditions: Valid name of directory (dirName) and world struct to set rooms of.
+// Post-conditions: World has its rooms set for later use in program. Returns 1 on success, otherwise 0.
+static int setRoomArray(char dirName[], struct world* world) {
+    struct roomFile* roomFiles = NULL;
+    int arrIdx = 0;
+    int capacity = 0;
+    struct arena parseArena = { NULL };
+
+    // Open directory, outputting error if it could not be opened
+    struct dirScanner scanner;
+    if (openDirScanner(&scanner, dirName) == 1) {
+        const struct linuxDirent64* fileInDir;
+        // Loop through contents (room files)
+        while ((fileInDir = nextDirEntry(&scanner)) != NULL) {
+            size_t nameLength = strlen(fileInDir->d_name);
+
+            // If _room file is found, open it relative to the directory and extract data
+            if ((fileInDir->d_type == DT_REG || fileInDir->d_type == DT_UNKNOWN) && nameLength > 5
+                && strcmp(&fileInDir->d_name[nameLength - 5], "_room") == 0) {
+                int fd = openat(scanner.fd, fileInDir->d_name, O_RDONLY | O_CLOEXEC);
+                FILE *fPointer = fd == -1 ? NULL : fdopen(fd, "r");
+                // Check to see if file was opened
+                if (fPointer == NULL) {
+                    if (fd != -1) {
+                        close(fd);
+                    }
+                    perror("Error opening a file.");
+                }
+                    // Output room name and room type to struct
+                else {
+                    // Make room for another room file struct
+                    if (arrIdx == capacity) {
+                        capacity = capacity == 0 ? 8 : capacity * 2;
+                        roomFiles = realloc(roomFiles, sizeof(struct roomFile) * capacity);
+                        if (roomFiles == NULL) {
+                            perror("Error allocating rooms");
+                            exit(1);
+                        }
+                    }
+
+                    // Set values in structs from files
+                    roomFiles[arrIdx] = readFile(fPointer, &parseArena);
+                    arrIdx++;
+
+                    fclose(fPointer);
+                }
+            }
+        }
+
+        // Close the directory used to access room files
+        closeDirScanner(&scanner);
+    }
+
+    int success = 0;
+    if (arrIdx > 0) {
+        success = internTextRooms(roomFiles, arrIdx, world);
+    }
+
+    // Room file strings are no longer needed once interned
+    freeArena(&parseArena);
+    free(roomFiles);
+
+    return success;
+}
+
+// Opens a packed world file and maps it into memory. The world's room records, adjacency array and string table
+// point straight into the mapping, so nothing is copied or allocated and pages are only read in as they are
+// touched. The mapping is shared and read only, so every adventure process on the same world shares the same
+// physical pages.
+// Pre-conditions: Valid name of packed world file and world struct to set rooms of.
+// Post-conditions: World has its rooms set. Returns 1 on success, otherwise 0 with the error reported.
+static int loadPackedWorld(char fileName[], struct world* world) {
+    int fileFd = open(fileName, O_RDONLY);
+    if (fileFd < 0) {
+        perror("Error opening world file");
+        return 0;
+    }
+
+    struct stat fileAttributes;
+    if (fstat(fileFd, &fileAttributes) != 0 || fileAttributes.st_size < (off_t) sizeof(struct packedHeader)) {
+        fprintf(stderr, "World file %s is not a packed world\n", fileName);
+        close(fileFd);
+        return 0;
+    }
+
+    size_t fileSize = (size_t) fileAttributes.st_size;
+    void* mapping = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fileFd, 0);
+    // The mapping stays valid after the file is closed
+    close(fileFd);
+    if (mapping == MAP_FAILED) {
+        perror("Error mapping world file");
+        return 0;
+    }
+    world->mapping = mapping;
+    world->mappingSize = fileSize;
+
+    if (worldValidate(world->mapping, fileSize) == 0) {
+        fprintf(stderr, "World file %s is not a valid packed world\n", fileName);
+        return 0;
+    }
+
+    const struct packedHeader* header = (const struct packedHeader*) world->mapping;
+    world->roomCount = (int) header->roomCount;
+    world->startRoom = (int) header->startRoom;
+    world->names = world->mapping + worldFindSection(header, WORLD_SECTION_STRINGS)->offset;
+    world->rooms =
+            (const struct packedRoom*) (world->mapping + worldFindSection(header, WORLD_SECTION_ROOMS)->offset);
+    world->connections =
+            (const uint32_t*) (world->mapping + worldFindSection(header, WORLD_SECTION_ADJACENCY)->offset);
+
+    // Use the name index stored by buildrooms, or build one for worlds without it
+    const struct packedSection* nameIndex = worldFindSection(header, WORLD_SECTION_NAME_INDEX);
+    if (nameIndex == NULL) {
+        if (buildNameIndex(world) == 0) {
+            return 0;
+        }
+    }
+    else {
+        world->nameIndex = (const struct packedNameIndex*) (world->mapping + nameIndex->offset);
+    }
+
+    // Same for the routes, which worlds from before they were stored don't have
+    const struct packedSection* routes = worldFindSection(header, WORLD_SECTION_ROUTES);
+    if (routes == NULL) {
+        buildRoutes(world);
+    }
+    else {
+        world->routes = (const struct packedRoutes*) (world->mapping + routes->offset);
+    }
+
+    return 1;
+}
+
+// Names the compiled world cache of a text world directory.
+// Pre-conditions: Pass name of world directory and char array of 300 chars for the cache name.
+// Post-conditions: Returns 1 with the cache name set, or 0 if the name is too long.
+static int worldCacheName(const char dirName[], char cacheName[300]) {
+    int length = snprintf(cacheName, 300, "%s%s", dirName, WORLD_CACHE_SUFFIX);
+
+    return length > 0 && length < 300;
+}
+
+// Loads the compiled cache of a text world directory if there is one and it was compiled from the directory as it
+// is now, going by the stamp in its source section. A missing cache is not an error.
+// Pre-conditions: Pass name of world directory, its attributes and world struct to load into.
+// Post-conditions: Returns 1 with the world loaded from the cache, otherwise 0 with nothing loaded.
+static int loadWorldCache(char dirName[], const struct stat* dirAttributes, struct world* world) {
+    char cacheName[300];
+    struct stat cacheAttributes;
+    if (worldCacheName(dirName, cacheName) == 0 || stat(cacheName, &cacheAttributes) != 0) {
+        return 0;
+    }
+
+    if (loadPackedWorld(cacheName, world) == 1) {
+        const struct packedHeader* header = (const struct packedHeader*) world->mapping;
+        const struct packedSection* sourceSection = worldFindSection(header, WORLD_SECTION_SOURCE);
+
+        // Only use the cache if it was compiled from this directory since it last changed
+        if (sourceSection != NULL) {
+            const struct packedSource* source = (const struct packedSource*) (world->mapping + sourceSection->offset);
+            if (source->device == (uint64_t) dirAttributes->st_dev && source->inode == (uint64_t) dirAttributes->st_ino
+                && source->modifiedSeconds == (int64_t) dirAttributes->st_mtim.tv_sec
+                && source->modifiedNanoseconds == (int64_t) dirAttributes->st_mtim.tv_nsec) {
+                return 1;
+            }
+        }
+    }
+
+    freeWorld(world);
+    memset(world, 0, sizeof(struct world));
+
+    return 0;
+}
+
+// Compiles a loaded text world into a packed world cache next to its directory, stamped with the directory's
+// attributes from before it was read. The cache is written under a temporary name and renamed into place, so other
+// processes never map a partly written cache. The cache only saves time, so a world that can't be cached, for
+// example in a read only directory, is still played as normal.
+// Pre-conditions: Pass name of world directory, its attributes from before the world was loaded and the world.
+// Post-conditions: Cache file exists if it could be written.
+static void writeWorldCache(char dirName[], const struct stat* dirAttributes, const struct world* world) {
+    static int cacheWrites = 0;
+    char cacheName[300];
+    char tempName[340];
+    if (worldCacheName(dirName, cacheName) == 0) {
+        return;
+    }
+    sprintf(tempName, "%s.%d.%d.tmp", cacheName, getpid(), __atomic_fetch_add(&cacheWrites, 1, __ATOMIC_RELAXED));
+
+    uint64_t stringsSize = 0;
+    uint64_t connectionCount = 0;
+    int roomNum;
+    // Size string table and adjacency array
+    for (roomNum = 0; roomNum < world->roomCount; roomNum++) {
+        stringsSize += world->rooms[roomNum].nameLength + 1;
+        connectionCount += world->rooms[roomNum].connectionCount;
+    }
+
+    uint64_t fileSize;
+    char* cacheOutput = worldCreate(world->roomCount, connectionCount, stringsSize, sizeof(struct packedSource),
+                                    &fileSize);
+    struct packedHeader* header = (struct packedHeader*) cacheOutput;
+
+    char* strings = cacheOutput + worldFindSection(header, WORLD_SECTION_STRINGS)->offset;
+    struct packedRoom* rooms =
+            (struct packedRoom*) (cacheOutput + worldFindSection(header, WORLD_SECTION_ROOMS)->offset);
+    uint32_t nameOffset = 0;
+    // Copy room records with their names packed into the cache's string table
+    for (roomNum = 0; roomNum < world->roomCount; roomNum++) {
+        rooms[roomNum] = world->rooms[roomNum];
+        rooms[roomNum].nameOffset = nameOffset;
+        memcpy(&strings[nameOffset], roomName(world, roomNum), world->rooms[roomNum].nameLength + 1);
+        nameOffset += world->rooms[roomNum].nameLength + 1;
+    }
+    memcpy(cacheOutput + worldFindSection(header, WORLD_SECTION_ADJACENCY)->offset, world->connections,
+           sizeof(uint32_t) * connectionCount);
+
+    struct packedSource* source =
+            (struct packedSource*) (cacheOutput + worldFindSection(header, WORLD_SECTION_SOURCE)->offset);
+    source->device = (uint64_t) dirAttributes->st_dev;
+    source->inode = (uint64_t) dirAttributes->st_ino;
+    source->modifiedSeconds = (int64_t) dirAttributes->st_mtim.tv_sec;
+    source->modifiedNanoseconds = (int64_t) dirAttributes->st_mtim.tv_nsec;
+
+    // Worlds without a start and an end room can't be packed, and are parsed on every load instead
+    if (worldFinish(cacheOutput) == 1) {
+        if (worldWriteFile(tempName, cacheOutput, fileSize) == 0 || rename(tempName, cacheName) != 0) {
+            unlink(tempName);
+        }
+    }
+
+    free(cacheOutput);
+}
+
+// Loads the world at the given path, which is either a packed world file or a directory of text room files. Text
+// worlds are loaded from their compiled cache while it matches the directory, otherwise parsed, and with writeCache
+// the parsed world is compiled into the cache for the next load.
+// Pre-conditions: Valid path of world, world struct to load into and 1 to write the cache, otherwise 0.
+// Post-conditions: World has its rooms set. Returns 1 on success, otherwise 0.
+static int loadWorldFrom(char worldName[], struct world* world, int writeCache) {
+    memset(world, 0, sizeof(struct world));
+
+    struct stat worldAttributes;
+    if (stat(worldName, &worldAttributes) != 0) {
+        perror("Could not find world");
+        return 0;
+    }
+
+    // Directories hold text room files
+    if (S_ISDIR(worldAttributes.st_mode)) {
+        if (loadWorldCache(worldName, &worldAttributes, world) == 1) {
+            return 1;
+        }
+        if (setRoomArray(worldName, world) == 0) {
+            return 0;
+        }
+
+        if (writeCache == 1) {
+            writeWorldCache(worldName, &worldAttributes, world);
+        }
+        return 1;
+    }
+
+    return loadPackedWorld(worldName, world);
+}
+
+// Loads the world at the given path, which is either a packed world file or a directory of text room files. An
+// existing cache of a text world is used, but none is written, so loading never changes the files of a world.
+// Pre-conditions: Valid path of world and world struct to load into.
+// Post-conditions: World has its rooms set. Returns 1 on success, otherwise 0.
+int loadWorld(char worldName[], struct world* world) {
+    return loadWorldFrom(worldName, world, 0);
+}
+
+// Loads a world like loadWorld and compiles a parsed text world into its cache next to the directory, so later
+// loads map the cache instead of parsing the room files.
+// Pre-conditions: Valid path of world and world struct to load into.
+// Post-conditions: World has its rooms set and a text world's cache is written. Returns 1 on success, otherwise 0.
+int loadWorldCached(char worldName[], struct world* world) {
+    return loadWorldFrom(worldName, world, 1);
+}
+
+// Tells whether a paged world failed to read its file. Lookups on a failed world return their error values, so callers
+// that get one can tell a missing room or route from a world that can't be played any more.
+// Pre-conditions: Pass loaded world.
+// Post-conditions: Returns 1 if the world is paged and could not read a room or route, otherwise 0.
+int worldReadFailed(const struct world* world) {
+    return world->roomCache != NULL && world->roomCache->failed == 1;
+}
+
+// Frees all memory held by a world. Text worlds own the arena their rooms were interned into while packed worlds only
+// own the mapping of the file, plus an arena if they lacked a name index or routes.
+// Pre-conditions: World was loaded by loadWorld.
+// Post-conditions: All memory of the world is freed.
+void freeWorld(struct world* world) {
+    if (world->roomCache != NULL) {
+        freeRoomCache(world->roomCache);
+    }
+    if (world->mapping != NULL) {
+        munmap(world->mapping, world->mappingSize);
+    }
+
+    if (world->arena != NULL) {
+        freeArena(world->arena);
+        free(world->arena);
+    }
+    memset(world, 0, sizeof(struct world));
+}
+
+// Initializes an empty path log.
+// Pre-conditions: Pass path log to initialize.
+// Post-conditions: Path log is empty with room for a short path.
+void initializePathLog(struct pathLog* path) {
+    path->count = 0;
+    path->capacity = 16;
+    path->rooms = malloc(sizeof(int) * path->capacity);
+    if (path->rooms == NULL) {
+        perror("Error allocating path");
+        exit(1);
+    }
+}
+
+// Appends a room to the path log, doubling its capacity when full.
+// Pre-conditions: Pass initialized path log and id of room visited.
+// Post-conditions: Room id is the last entry in the path log.
+void recordStep(struct pathLog* path, int roomId) {
+    if (path->count == path->capacity) {
+        int* rooms = realloc(path->rooms, sizeof(int) * (size_t) path->capacity * 2);
+        if (rooms == NULL) {
+            perror("Error growing path");
+            exit(1);
+        }
+        path->rooms = rooms;
+        path->capacity *= 2;
+    }
+
+    path->rooms[path->count] = roomId;
+    path->count++;
+}
+
+// Frees memory held by a path log.
+// Pre-conditions: Pass initialized path log.
+// Post-conditions: Path log memory is freed.
+void freePathLog(struct pathLog* path) {
+    free(path->rooms);
+    path->rooms = NULL;
+    path->count = 0;
+    path->capacity = 0;
+}
+
+// Initializes a session at the start room of a world.
+// Pre-conditions: Pass session to initialize and loaded world, which must outlive the session.
+// Post-conditions: Session is at the start room with an empty path.
+void initializeSession(struct session* session, const struct world* world) {
+    session->world = world;
+    session->currentRoom = world->startRoom;
+    initializePathLog(&session->path);
+}
+
+// Starts a new game in a session, keeping the memory of its path for the next game.
+// Pre-conditions: Pass initialized session.
+// Post-conditions: Session is at the start room with an empty path.
+void resetSession(struct session* session) {
+    session->currentRoom = session->world->startRoom;
+    session->path.count = 0;
+}
+
+// Returns the rooms connected to a session's current room.
+// Pre-conditions: Pass initialized session and pointer to hold the connections.
+// Post-conditions: Connections point at the room ids of the connected rooms. Returns their number. For paged worlds
+// the ids are a copy that stays valid until the next call on a session of the same world, and -1 is returned with
+// no connections if the room could not be read.
+int sessionNeighbors(const struct session* session, const uint32_t** connections) {
+    struct roomCache* cache = session->world->roomCache;
+
+    // Copy the connections out of the room cache, since looking up their names may evict the current room
+    if (cache != NULL) {
+        const struct cachedRoom* room = fetchRoom(session->world, session->currentRoom);
+        if (room == NULL) {
+            *connections = NULL;
+            return -1;
+        }
+        if (room->record.connectionCount > cache->neighborCapacity) {
+            free(cache->neighbors);
+            cache->neighborCapacity = room->record.connectionCount;
+            cache->neighbors = malloc(sizeof(uint32_t) * cache->neighborCapacity);
+            if (cache->neighbors == NULL) {
+                perror("Error allocating connections");
+                exit(1);
+            }
+        }
+        memcpy(cache->neighbors, room->connections, sizeof(uint32_t) * room->record.connectionCount);
+        *connections = cache->neighbors;
+
+        return room->record.connectionCount;
+    }
+
+    const struct packedRoom* roomObj = &session->world->rooms[session->currentRoom];
+    *connections = &session->world->connections[roomObj->firstConnection];
+
+    return roomObj->connectionCount;
+}
+
+// Moves a session to a connected room and records the step in its path.
+// Pre-conditions: Pass initialized session and id of room to move to, or -1 for no room.
+// Post-conditions: Returns STEP_INVALID without moving if the room is not connected to the current room, or a
+// paged world could not read it, otherwise moves and returns STEP_END if the room is the end room or STEP_MOVED if
+// not.
+int stepSession(struct session* session, int roomId) {
+    const uint32_t* connections;
+    int connectionCount = sessionNeighbors(session, &connections);
+
+    int roomConnIdx;
+    // Check if the room is one of the connections and move there if so
+    for (roomConnIdx = 0; roomConnIdx < connectionCount; roomConnIdx++) {
+        if (connections[roomConnIdx] == (uint32_t) roomId) {
+            const struct packedRoom* roomObj;
+            if (session->world->roomCache != NULL) {
+                const struct cachedRoom* room = fetchRoom(session->world, roomId);
+                if (room == NULL) {
+                    return STEP_INVALID;
+                }
+                roomObj = &room->record;
+            }
+            else {
+                roomObj = &session->world->rooms[roomId];
+            }
+
+            session->currentRoom = roomId;
+            recordStep(&session->path, roomId);
+
+            return roomObj->type == ROOM_TYPE_END ? STEP_END : STEP_MOVED;
+        }
+    }
+
+    return STEP_INVALID;
+}
+
+// Frees memory held by a session.
+// Pre-conditions: Pass initialized session.
+// Post-conditions: Session memory is freed.
+void freeSession(struct session* session) {
+    freePathLog(&session->path);
+}
+
+// Finds a shortest path from a room to the end room with a breadth first search over the world's connections.
+// Pre-conditions: Pass loaded world, id of room to start from and initialized path log to hold the path.
+// Post-conditions: Returns number of steps of a shortest path, with the rooms after fromRoom up to and including
+// the end room in path, or -1 with path empty if the end room cannot be reached.
+int solveWorld(const struct world* world, int fromRoom, struct pathLog* path) {
+    int32_t* parents = malloc(sizeof(int32_t) * world->roomCount);
+    int32_t* queue = malloc(sizeof(int32_t) * world->roomCount);
+    if (parents == NULL || queue == NULL) {
+        perror("Error allocating search");
+        exit(1);
+    }
+
+    int roomNum;
+    for (roomNum = 0; roomNum < world->roomCount; roomNum++) {
+        parents[roomNum] = -1;
+    }
+
+    int queueHead = 0;
+    int queueTail = 0;
+    int endRoom = -1;
+    parents[fromRoom] = fromRoom;
+    queue[queueTail++] = fromRoom;
+
+    // Visit rooms in order of distance until the end room is found
+    while (queueHead < queueTail && endRoom == -1) {
+        int room = queue[queueHead++];
+        if (world->rooms[room].type == ROOM_TYPE_END) {
+            endRoom = room;
+            break;
+        }
+
+        const struct packedRoom* roomObj = &world->rooms[room];
+        const uint32_t* connections = &world->connections[roomObj->firstConnection];
+        int conn;
+        for (conn = 0; conn < roomObj->connectionCount; conn++) {
+            if (parents[connections[conn]] == -1) {
+                parents[connections[conn]] = room;
+                queue[queueTail++] = (int32_t) connections[conn];
+            }
+        }
+    }
+
+    path->count = 0;
+    int steps = -1;
+    if (endRoom != -1) {
+        // Walk back from the end room, reusing the queue for the reversed path
+        steps = 0;
+        int room;
+        for (room = endRoom; room != fromRoom; room = parents[room]) {
+            queue[steps++] = room;
+        }
+
+        int step;
+        for (step = steps - 1; step >= 0; step--) {
+            recordStep(path, queue[step]);
+        }
+    }
+
+    free(parents);
+    free(queue);
+
+    return steps;
+}
+
+// Finds the next room on a shortest path from a room to the end room, answered from the world's routes.
+// Pre-conditions: Pass loaded world and room id.
+// Post-conditions: Returns id of the room to move to, or -1 if the end room can't be reached, the room is the end,
+// or a paged world could not read its routes.
+int hintRoom(const struct world* world, int roomId) {
+    uint32_t nextRoom;
+    if (world->roomCache != NULL) {
+        nextRoom = readWorldEntry(world->roomCache, world->roomCache->routesOffset + sizeof(struct packedRoutes),
+                                  (uint64_t) world->roomCount + roomId);
+    }
+    else if (world->routes != NULL) {
+        nextRoom = ((const uint32_t*) (world->routes + 1))[world->roomCount + roomId];
+    }
+    else {
+        return -1;
+    }
+
+    // Paged worlds were not validated whole, so don't trust room ids read from them
+    return nextRoom >= (uint32_t) world->roomCount ? -1 : (int) nextRoom;
+}
+
+// Finds the number of steps on a shortest path from a room to the end room, answered from the world's routes.
+// Pre-conditions: Pass loaded world and room id.
+// Post-conditions: Returns number of steps, or -1 if the end room can't be reached or a paged world could not read
+// its routes.
+int distanceToEnd(const struct world* world, int roomId) {
+    uint32_t distance;
+    if (world->roomCache != NULL) {
+        distance = readWorldEntry(world->roomCache, world->roomCache->routesOffset + sizeof(struct packedRoutes),
+                                  roomId);
+    }
+    else if (world->routes != NULL) {
+        distance = ((const uint32_t*) (world->routes + 1))[roomId];
+    }
+    else {
+        return -1;
+    }
+
+    return distance == WORLD_ROUTE_NONE ? -1 : (int) distance;
+}
+
+// Finds the next room on a shortest path between any two rooms, answered from the world's next hop matrix.
+// Pre-conditions: Pass loaded world and ids of the rooms to move from and to.
+// Post-conditions: Returns id of the room to move to, or -1 if there is no route, the rooms are the same, the world
+// is too large to have a matrix, or a paged world could not read it.
+int nextHop(const struct world* world, int fromRoom, int toRoom) {
+    struct roomCache* cache = world->roomCache;
+    uint8_t entry;
+    if (cache != NULL && cache->routes.matrixRooms != 0) {
+        if (readWorldBytes(cache, &entry, 1, cache->routesOffset + sizeof(struct packedRoutes)
+                                             + sizeof(uint32_t) * 2 * (uint64_t) world->roomCount
+                                             + (uint64_t) fromRoom * cache->routes.matrixRooms + toRoom) == 0) {
+            return -1;
+        }
+    }
+    else if (cache == NULL && world->routes != NULL && world->routes->matrixRooms != 0) {
+        const uint8_t* matrix = (const uint8_t*) ((const uint32_t*) (world->routes + 1) + 2 * world->roomCount);
+        entry = matrix[(size_t) fromRoom * world->routes->matrixRooms + toRoom];
+    }
+    else {
+        return -1;
+    }
+
+    if (entry == WORLD_ROUTE_MATRIX_NONE) {
+        return -1;
+    }
+
+    // The entry is an index into the room's connections
+    if (cache != NULL) {
+        const struct cachedRoom* room = fetchRoom(world, fromRoom);
+        return room != NULL && entry < room->record.connectionCount ? (int) room->connections[entry] : -1;
+    }
+
+    return (int) world->connections[world->rooms[fromRoom].firstConnection + entry];
+}
+
+// Initializes a batch of count sessions on a world, all at the start room. Worlds of up to BATCH_MASK_ROOM_LIMIT
+// rooms get a bit mask of connected rooms per room, so stepping a session is one mask test.
+// Pre-conditions: Pass batch to initialize, loaded world which must outlive the batch, and number of sessions.
+// Post-conditions: Returns 1 with every session at the start room, otherwise 0 with error output.
+int initializeBatch(struct sessionBatch* batch, const struct world* world, int count) {
+    memset(batch, 0, sizeof(struct sessionBatch));
+    batch->world = world;
+    batch->count = count;
+    batch->endRoom = -1;
+
+    if (world->roomCache != NULL) {
+        fprintf(stderr, "Session batches need a world loaded whole\n");
+        return 0;
+    }
+
+    batch->currentRooms = malloc(sizeof(int32_t) * count);
+    batch->stepCounts = malloc(sizeof(uint32_t) * count);
+    batch->done = malloc((size_t) count);
+    if (batch->currentRooms == NULL || batch->stepCounts == NULL || batch->done == NULL) {
+        perror("Error allocating session batch");
+        freeBatch(batch);
+        return 0;
+    }
+
+    int roomNum;
+    for (roomNum = 0; roomNum < world->roomCount; roomNum++) {
+        if (world->rooms[roomNum].type == ROOM_TYPE_END) {
+            batch->endRoom = roomNum;
+        }
+    }
+
+    // Build neighbour masks for small worlds
+    if (world->roomCount <= BATCH_MASK_ROOM_LIMIT) {
+        batch->neighborMasks = calloc(BATCH_MASK_ROOM_LIMIT, sizeof(uint64_t));
+        if (batch->neighborMasks == NULL) {
+            perror("Error allocating session batch");
+            freeBatch(batch);
+            return 0;
+        }
+
+        for (roomNum = 0; roomNum < world->roomCount; roomNum++) {
+            const struct packedRoom* roomObj = &world->rooms[roomNum];
+            int conn;
+            for (conn = 0; conn < roomObj->connectionCount; conn++) {
+                batch->neighborMasks[roomNum] |= (uint64_t) 1 << world->connections[roomObj->firstConnection + conn];
+            }
+        }
+    }
+
+    resetBatch(batch);
+
+    return 1;
+}
+
+// Moves every session of a batch back to the start room.
+// Pre-conditions: Pass initialized batch.
+// Post-conditions: Every session is at the start room with no steps and not done.
+void resetBatch(struct sessionBatch* batch) {
+    int sessionIdx;
+    for (sessionIdx = 0; sessionIdx < batch->count; sessionIdx++) {
+        batch->currentRooms[sessionIdx] = batch->world->startRoom;
+        batch->stepCounts[sessionIdx] = 0;
+        batch->done[sessionIdx] = 0;
+    }
+}
+
+// Moves every session of a batch that reached the end room back to the start room.
+// Pre-conditions: Pass initialized batch.
+// Post-conditions: Finished sessions are at the start room with no steps and not done. Returns their number.
+int resetFinished(struct sessionBatch* batch) {
+    int finished = 0;
+
+    int sessionIdx;
+    for (sessionIdx = 0; sessionIdx < batch->count; sessionIdx++) {
+        int32_t done = batch->done[sessionIdx];
+        int32_t keep = done - 1;
+
+        // Branch free so the loop vectorizes: keep is all ones for sessions still playing
+        batch->currentRooms[sessionIdx] = (batch->currentRooms[sessionIdx] & keep)
+                                          | (batch->world->startRoom & ~keep);
+        batch->stepCounts[sessionIdx] &= (uint32_t) keep;
+        batch->done[sessionIdx] = 0;
+        finished += done;
+    }
+
+    return finished;
+}
+
+// Steps sessions with neighbour masks, four at a time with AVX2 when the compiler targets it. Each session's row
+// mask is gathered by current room and shifted right by the action, so the low bit says whether the action is a
+// connected room. Actions outside 0 to 63, including negative ones, shift the mask out entirely.
+// Pre-conditions: Pass batch with neighbour masks and one action per session.
+// Post-conditions: Sessions with valid actions have moved. Returns number of sessions moved.
+static int stepBatchMasks(struct sessionBatch* batch, const int32_t actions[]) {
+    const uint64_t* masks = batch->neighborMasks;
+    int32_t* currentRooms = batch->currentRooms;
+    uint32_t* stepCounts = batch->stepCounts;
+    uint8_t* done = batch->done;
+    int moved = 0;
+    int sessionIdx = 0;
+
+#ifdef __AVX2__
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i endRoom = _mm_set1_epi32(batch->endRoom);
+    const __m256i lowHalves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    const __m128i packBytes = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    for (; sessionIdx + 4 <= batch->count; sessionIdx += 4) {
+        __m128i rooms = _mm_loadu_si128((const __m128i*) &currentRooms[sessionIdx]);
+        __m128i action = _mm_loadu_si128((const __m128i*) &actions[sessionIdx]);
+        __m128i steps = _mm_loadu_si128((const __m128i*) &stepCounts[sessionIdx]);
+        int32_t doneBytes;
+        memcpy(&doneBytes, &done[sessionIdx], sizeof(int32_t));
+        __m128i finished = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(doneBytes));
+
+        // Test the action's bit in each session's row mask
+        __m256i rowMasks = _mm256_i32gather_epi64((const long long*) masks, rooms, 8);
+        __m256i shifted = _mm256_srlv_epi64(rowMasks, _mm256_cvtepi32_epi64(action));
+        __m128i connected = _mm_and_si128(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(shifted, lowHalves)),
+                                          one);
+
+        // Sessions that are done ignore their action
+        __m128i valid = _mm_andnot_si128(finished, connected);
+        __m128i validMask = _mm_sub_epi32(_mm_setzero_si128(), valid);
+
+        rooms = _mm_blendv_epi8(rooms, action, validMask);
+        steps = _mm_add_epi32(steps, valid);
+        finished = _mm_or_si128(finished, _mm_and_si128(_mm_cmpeq_epi32(action, endRoom), valid));
+
+        _mm_storeu_si128((__m128i*) &currentRooms[sessionIdx], rooms);
+        _mm_storeu_si128((__m128i*) &stepCounts[sessionIdx], steps);
+        doneBytes = _mm_cvtsi128_si32(_mm_shuffle_epi8(finished, packBytes));
+        memcpy(&done[sessionIdx], &doneBytes, sizeof(int32_t));
+        moved += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(validMask)));
+    }
+#endif
+
+    // Scalar fallback, and the sessions after the last whole block
+    for (; sessionIdx < batch->count; sessionIdx++) {
+        uint32_t action = (uint32_t) actions[sessionIdx];
+        uint32_t valid = action < 64 ? (uint32_t) (masks[currentRooms[sessionIdx]] >> action) & 1 : 0;
+        valid &= (uint32_t) (1 - done[sessionIdx]);
+
+        currentRooms[sessionIdx] = valid == 1 ? (int32_t) action : currentRooms[sessionIdx];
+        stepCounts[sessionIdx] += valid;
+        done[sessionIdx] |= (uint8_t) (valid & ((int32_t) action == batch->endRoom));
+        moved += (int) valid;
+    }
+
+    return moved;
+}
+
+// Steps every session of a batch by one action. An action is the id of the room to move to, and moves the session
+// only if that room is connected to its current room and the session has not reached the end room yet. Sessions
+// that reach the end room are marked done and ignore actions until reset.
+// Pre-conditions: Pass initialized batch and array of one action per session.
+// Post-conditions: Sessions with valid actions have moved and counted a step. Returns number of sessions moved.
+int stepBatch(struct sessionBatch* batch, const int32_t actions[]) {
+    if (batch->neighborMasks != NULL) {
+        return stepBatchMasks(batch, actions);
+    }
+
+    const struct world* world = batch->world;
+    int moved = 0;
+
+    int sessionIdx;
+    // Larger worlds check the connections of each session's room
+    for (sessionIdx = 0; sessionIdx < batch->count; sessionIdx++) {
+        if (batch->done[sessionIdx] == 1) {
+            continue;
+        }
+
+        const struct packedRoom* roomObj = &world->rooms[batch->currentRooms[sessionIdx]];
+        const uint32_t* connections = &world->connections[roomObj->firstConnection];
+        int conn;
+        for (conn = 0; conn < roomObj->connectionCount; conn++) {
+            if (connections[conn] == (uint32_t) actions[sessionIdx]) {
+                batch->currentRooms[sessionIdx] = actions[sessionIdx];
+                batch->stepCounts[sessionIdx]++;
+                batch->done[sessionIdx] = actions[sessionIdx] == batch->endRoom;
+                moved++;
+                break;
+            }
+        }
+    }
+
+    return moved;
+}
+
+// Frees memory held by a batch.
+// Pre-conditions: Pass batch initialized by initializeBatch, even one that failed.
+// Post-conditions: Batch memory is freed.
+void freeBatch(struct sessionBatch* batch) {
+    free(batch->currentRooms);
+    free(batch->stepCounts);
+    free(batch->done);
+    free(batch->neighborMasks);
+    memset(batch, 0, sizeof(struct sessionBatch));
+}
@@ -0,0 +1,155 @@
+// Author: Justin Tromp
+// Date: 04/25/2020
+// Description: libadventure, the world loading and move logic of adventure as a library for bots and agents that
+// play in process. Worlds are loaded once, from a packed world file or a directory of text room files, and any
+// number of sessions play on them. Text worlds loaded with loadWorldCached are compiled into a packed world cache
+// next to their directory, and later loads map the cache instead of parsing the room files. Rooms are integer
+// ids from 0 to roomCount - 1, and stepping a session only checks the current room's connections and records the
+// step, so nothing is parsed, printed or allocated per step once the path has grown to its usual length. Agents
+// that play many games at once can hold them in a sessionBatch instead, which keeps sessions as arrays and steps
+// all of them with one array of actions.
+//
+// Build the library and link it with:
+//   gcc -O2 -c trompj.libadventure.c
+// Add -mavx2 (or -march=native on a machine with AVX2) to step batches four sessions per instruction; without it
+// batches use the scalar code path.
+//   ar rcs libadventure.a trompj.libadventure.o
+//   gcc -O2 -o agent agent.c libadventure.a
+// adventure itself is built with:
+//   gcc -o adventure trompj.adventure.c trompj.libadventure.c -lpthread
+//
+// A minimal agent:
+//   struct world world;
+//   struct session session;
+//   loadWorld(worldName, &world);
+//   initializeSession(&session, &world);
+//   const uint32_t* connections;
+//   int count = sessionNeighbors(&session, &connections);
+//   if (stepSession(&session, (int) connections[0]) == STEP_END) { resetSession(&session); }
+
+#ifndef TROMPJ_LIBADVENTURE_H
+#define TROMPJ_LIBADVENTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "trompj.world.h"
+
+// Rooms kept in memory by a paged world unless told otherwise, and the fewest it keeps
+#define ROOM_CACHE_DEFAULT_ROOMS 4096
+#define ROOM_CACHE_MIN_ROOMS 16
+
+// Most rooms a world can have for sessionBatch to validate actions with neighbour bit masks
+#define BATCH_MASK_ROOM_LIMIT 64
+
+// Results of stepSession
+#define STEP_INVALID -1
+#define STEP_MOVED 0
+#define STEP_END 1
+
+// Struct for a loaded world. Rooms are fixed size packedRoom records (see trompj.world.h) indexed by room id, with
+// connections stored as room ids in one adjacency array and names in one string table. For packed worlds all three
+// point into mapping, a read only memory map of the whole file. Text worlds intern their names at load time into
+// arena, a bump allocator owned by the world and freed in one call. nameIndex maps a room name to its room id in
+// O(1) and routes holds the shortest path tables hints are answered from; both come from the packed world when
+// buildrooms stored them, otherwise they are built at load time into arena. Paged worlds leave all of these unset
+// and read rooms through roomCache as they are needed.
+struct world {
+    int roomCount;
+    int startRoom;
+    const struct packedRoom* rooms;
+    const uint32_t* connections;
+    const char* names;
+    const struct packedNameIndex* nameIndex;
+    char* mapping;
+    size_t mappingSize;
+    struct arena* arena;
+    const struct packedRoutes* routes;
+    struct roomCache* roomCache;
+};
+
+// Struct holding the rooms visited in a game as room ids. The array grows geometrically, so recording a step is
+// O(1) amortized and does not allocate once the capacity covers the path.
+struct pathLog {
+    int* rooms;
+    int count;
+    int capacity;
+};
+
+// Struct for a game played on a world: the room the player is in and the rooms visited since the start room.
+struct session {
+    const struct world* world;
+    int currentRoom;
+    struct pathLog path;
+};
+
+// Struct for a batch of sessions on one world, stored as arrays indexed by session: current room, steps taken and
+// whether the session reached the end room. Worlds of up to BATCH_MASK_ROOM_LIMIT rooms also get a bit mask of
+// connected rooms per room.
+struct sessionBatch {
+    const struct world* world;
+    int count;
+    int endRoom;
+    int32_t* currentRooms;
+    uint32_t* stepCounts;
+    uint8_t* done;
+    uint64_t* neighborMasks;
+};
+
+// Finds the newest world in the current directory, preferring the latest world link kept by buildrooms.
+void mostRecentRooms(char dirName[128]);
+
+// Finds the newest world in a directory from the pid and world number in the world names.
+void scanNewestWorld(const char* path, char dirName[128]);
+
+// Loads a packed world file or a directory of text room files. Returns 1 on success, otherwise 0.
+int loadWorld(char worldName[], struct world* world);
+
+// Loads a world like loadWorld and also writes the compiled cache of a text world next to its directory.
+int loadWorldCached(char worldName[], struct world* world);
+
+// Opens a packed world that reads its rooms on demand into a cache of cacheRooms rooms. Paged worlds support
+// sessions, room names and route lookups, but not solveWorld or session batches.
+int loadPagedWorld(char worldName[], struct world* world, int cacheRooms);
+
+// Returns 1 once a paged world could not read a room or route from its file, otherwise 0. From then on roomName
+// returns NULL, sessionNeighbors -1, stepSession STEP_INVALID and the route lookups -1.
+int worldReadFailed(const struct world* world);
+
+// Frees a world loaded by loadWorld or loadPagedWorld, even one that failed to load.
+void freeWorld(struct world* world);
+
+// Returns the name of a room.
+const char* roomName(const struct world* world, int roomId);
+
+// Returns the id of the room with a name, or -1 if there is none.
+int findRoomByName(const struct world* world, const char* name);
+
+// Path log of room ids.
+void initializePathLog(struct pathLog* path);
+void recordStep(struct pathLog* path, int roomId);
+void freePathLog(struct pathLog* path);
+
+// Finds a shortest path from a room to the end room. Returns its number of steps, or -1 if there is none.
+int solveWorld(const struct world* world, int fromRoom, struct pathLog* path);
+
+// Shortest path lookups in O(1) from the world's routes. Each returns -1 when there is no answer.
+int hintRoom(const struct world* world, int roomId);
+int distanceToEnd(const struct world* world, int roomId);
+int nextHop(const struct world* world, int fromRoom, int toRoom);
+
+// Sessions. stepSession returns STEP_INVALID, STEP_MOVED or STEP_END.
+void initializeSession(struct session* session, const struct world* world);
+void resetSession(struct session* session);
+int sessionNeighbors(const struct session* session, const uint32_t** connections);
+int stepSession(struct session* session, int roomId);
+void freeSession(struct session* session);
+
+// Session batches. stepBatch applies one action, the id of the room to move to, per session and returns the number
+// of sessions moved. Done sessions ignore actions until reset.
+int initializeBatch(struct sessionBatch* batch, const struct world* world, int count);
+void resetBatch(struct sessionBatch* batch);
+int resetFinished(struct sessionBatch* batch);
+int stepBatch(struct sessionBatch* batch, const int32_t actions[]);
+void freeBatch(struct sessionBatch* batch);
+
+#endif
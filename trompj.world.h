@@ -0,0 +1,812 @@
+// Author: Justin Tromp
+// Date: 04/25/2020
+// Description: Packed world file format shared by buildrooms and adventure. A packed world is a single file that
+// holds a fixed size header followed by sections. The header lists each section by id, offset and size, so new
+// sections can be added without breaking older readers. Sections are 8 byte aligned and all values are stored in
+// host byte order.
+//   STRINGS    - room names, each terminated by a NUL character
+//   ROOMS      - one packedRoom record per room, indexed by room id
+//   ADJACENCY  - uint32_t room ids of every room's connections, stored back to back in room order
+//   NAME_INDEX - optional minimal perfect hash from room name to room id (see worldBuildNameIndex)
+//   ROUTES     - optional shortest path tables: distance and next hop to the end room for every room, plus a next
+//                hop matrix between all pairs of rooms for small worlds (see worldBuildRoutes)
+//   SOURCE     - optional stamp of the text world directory a world cache was compiled from
+
+#ifndef TROMPJ_WORLD_H
+#define TROMPJ_WORLD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define WORLD_MAGIC "TRMPJWLD"
+#define WORLD_VERSION 1
+#define WORLD_MAX_SECTIONS 8
+
+// Buffer size that holds any room name written by buildrooms, including the terminator
+#define WORLD_NAME_SIZE 16
+
+// Prefix of every world name, followed by the pid of the buildrooms run and for batch worlds the world number
+#define WORLD_NAME_PREFIX "trompj.rooms."
+
+// File name suffix of packed worlds
+#define WORLD_FILE_SUFFIX ".world"
+
+// Suffix added to the name of a text world directory to name its compiled world cache, a packed world file next to
+// the directory. Names with this suffix are not world names, so directory scans for worlds skip caches.
+#define WORLD_CACHE_SUFFIX ".cache"
+
+// Symlink that buildrooms points at the newest world it built, replaced atomically with rename. The name does not
+// contain the world prefix, so directory scans for worlds skip it.
+#define WORLD_LATEST_LINK "trompj.latest_rooms"
+
+// Section ids
+#define WORLD_SECTION_STRINGS 1
+#define WORLD_SECTION_ROOMS 2
+#define WORLD_SECTION_ADJACENCY 3
+#define WORLD_SECTION_NAME_INDEX 4
+#define WORLD_SECTION_ROUTES 5
+#define WORLD_SECTION_SOURCE 6
+
+// Average names per name index bucket, displacements tried per bucket and seeds tried per name index. A bucket
+// tries at most WORLD_NAME_DISPLACEMENTS_PER_SLOT displacements per slot of the index, since the last buckets placed
+// find a free slot within about slotCount tries, and never more than WORLD_NAME_MAX_DISPLACEMENT.
+#define WORLD_NAME_BUCKET_SIZE 4
+#define WORLD_NAME_DISPLACEMENTS_PER_SLOT 16
+#define WORLD_NAME_MAX_DISPLACEMENT (1u << 24)
+#define WORLD_NAME_MAX_SEEDS 16
+
+// Largest world that stores the all pairs next hop matrix. Its entries are one byte each, so the matrix of the
+// largest world takes 64 KB while larger worlds only keep the linear end room tables.
+#define WORLD_ROUTE_MATRIX_LIMIT 256
+
+// Distance and next hop of rooms that cannot reach the end room, and matrix entry of pairs without a route
+#define WORLD_ROUTE_NONE 0xFFFFFFFFu
+#define WORLD_ROUTE_MATRIX_NONE 0xFF
+
+// Room types stored in packedRoom.type
+#define ROOM_TYPE_START 0
+#define ROOM_TYPE_MID 1
+#define ROOM_TYPE_END 2
+
+// Location of one section in the file.
+struct packedSection {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Header at the start of every packed world file.
+struct packedHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint32_t roomCount;
+    uint32_t connectionCount;
+    uint32_t startRoom;
+    uint32_t endRoom;
+    uint64_t fileSize;
+    struct packedSection sections[WORLD_MAX_SECTIONS];
+};
+
+// Fixed size record of one room. The room's name is at nameOffset in the string table and its connections are
+// connectionCount entries of the adjacency array starting at firstConnection.
+struct packedRoom {
+    uint32_t nameOffset;
+    uint32_t firstConnection;
+    uint16_t connectionCount;
+    uint8_t type;
+    uint8_t nameLength;
+};
+
+// Header of the name index section. It is followed by bucketCount uint32_t displacements and slotCount uint32_t
+// room ids, one per slot.
+struct packedNameIndex {
+    uint64_t seed;
+    uint32_t bucketCount;
+    uint32_t slotCount;
+};
+
+// Header of the routes section. It is followed by roomCount uint32_t distances to the end room, roomCount uint32_t
+// room ids of the next room towards the end room, and when matrixRooms is not 0 a matrixRooms by matrixRooms byte
+// matrix. Entry from * matrixRooms + to of the matrix is the index in room from's connections of the next room on
+// a shortest path to room to.
+struct packedRoutes {
+    uint32_t endRoom;
+    uint32_t matrixRooms;
+};
+
+// Source section of a world cache: the device, inode and modification time of the text world directory it was
+// compiled from. Adding, removing or renaming a room file changes the directory's modification time, so a cache
+// whose stamp still matches the directory holds the same rooms.
+struct packedSource {
+    uint64_t device;
+    uint64_t inode;
+    int64_t modifiedSeconds;
+    int64_t modifiedNanoseconds;
+};
+
+// Rounds a section size or offset up to the 8 byte section alignment.
+// Pre-conditions: Pass size to round.
+// Post-conditions: Returns aligned size.
+static inline uint64_t worldAlign(uint64_t size) {
+    return (size + 7) & ~(uint64_t) 7;
+}
+
+// Finds a section in a packed world.
+// Pre-conditions: Pass header of a validated packed world and the section id.
+// Post-conditions: Returns pointer to the section entry, or NULL if the world has no such section.
+static inline const struct packedSection* worldFindSection(const struct packedHeader* header, uint32_t id) {
+    uint32_t i;
+    for (i = 0; i < header->sectionCount; i++) {
+        if (header->sections[i].id == id) {
+            return &header->sections[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Mixes the bits of a 64 bit value (murmur3 finalizer).
+// Pre-conditions: Pass value to mix.
+// Post-conditions: Returns mixed value.
+static inline uint64_t worldMix64(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    value ^= value >> 33;
+
+    return value;
+}
+
+// Hashes a room name with the given seed (FNV-1a over the characters, then mixed).
+// Pre-conditions: Pass NUL terminated name and hash seed.
+// Post-conditions: Returns 64 bit hash of the name.
+static inline uint64_t worldHashName(const char* name, uint64_t seed) {
+    uint64_t hash = 0xCBF29CE484222325ULL ^ seed;
+    while (*name != '\0') {
+        hash ^= (unsigned char) *name;
+        hash *= 0x100000001B3ULL;
+        name++;
+    }
+
+    return worldMix64(hash);
+}
+
+// Maps the upper 32 bits of a hash onto the range 0 to bound-1 with a multiply and shift.
+// Pre-conditions: Pass hash and bound.
+// Post-conditions: Returns value below bound.
+static inline uint32_t worldReduce(uint64_t hash, uint32_t bound) {
+    return (uint32_t) (((hash >> 32) * (uint64_t) bound) >> 32);
+}
+
+// Slot of a name hash in the name index for the given bucket displacement.
+// Pre-conditions: Pass name hash, displacement of its bucket and number of slots.
+// Post-conditions: Returns slot below slotCount.
+static inline uint32_t worldNameSlot(uint64_t hash, uint32_t displacement, uint32_t slotCount) {
+    return worldReduce(worldMix64(hash ^ ((uint64_t) displacement * 0x9E3779B97F4A7C15ULL)), slotCount);
+}
+
+// Size in bytes of a name index section for the given number of rooms.
+// Pre-conditions: Pass number of rooms.
+// Post-conditions: Returns section size.
+static inline uint64_t worldNameIndexSize(uint32_t roomCount) {
+    uint32_t bucketCount = roomCount / WORLD_NAME_BUCKET_SIZE + 1;
+
+    return sizeof(struct packedNameIndex) + sizeof(uint32_t) * ((uint64_t) bucketCount + roomCount);
+}
+
+// Looks up a name in a name index. The index only maps names it was built from, so callers must compare the
+// returned room's name with the name looked up.
+// Pre-conditions: Pass valid name index section and NUL terminated name.
+// Post-conditions: Returns id of the only room the name can belong to.
+static inline uint32_t worldNameIndexLookup(const struct packedNameIndex* index, const char* name) {
+    const uint32_t* displacements = (const uint32_t*) (index + 1);
+    const uint32_t* slots = displacements + index->bucketCount;
+    uint64_t hash = worldHashName(name, index->seed);
+    uint32_t displacement = displacements[worldReduce(hash, index->bucketCount)];
+
+    return slots[worldNameSlot(hash, displacement, index->slotCount)];
+}
+
+// Builds a minimal perfect hash of room names by hash and displace. Names are hashed into buckets of about
+// WORLD_NAME_BUCKET_SIZE names, then buckets are placed largest first: each tries displacements until all of its
+// names land on free slots. There are exactly as many slots as rooms and each slot holds the id of the room that
+// hashes to it, so a lookup is two array reads and one name comparison. Names with the same hash can never be
+// separated, so duplicate names fail at once and other equal hashes move on to a new seed, as does a bucket that
+// can't be placed.
+// Pre-conditions: Pass array of count unique names and output buffer of worldNameIndexSize(count) bytes.
+// Post-conditions: Fills the name index and returns 1, or returns 0 if no index could be built or names repeat.
+static inline int worldBuildNameIndex(const char* const names[], uint32_t count, void* out) {
+    struct packedNameIndex* index = out;
+    uint32_t bucketCount = count / WORLD_NAME_BUCKET_SIZE + 1;
+    uint32_t* displacements = (uint32_t*) (index + 1);
+    uint32_t* slots = displacements + bucketCount;
+
+    uint64_t* hashes = malloc(sizeof(uint64_t) * ((uint64_t) count + 1));
+    uint32_t* bucketStart = malloc(sizeof(uint32_t) * ((uint64_t) bucketCount + 1));
+    uint32_t* bucketKeys = malloc(sizeof(uint32_t) * ((uint64_t) count + 1));
+    uint32_t* bucketOrder = malloc(sizeof(uint32_t) * (uint64_t) bucketCount);
+    uint32_t* sizeStart = calloc(WORLD_NAME_BUCKET_SIZE * 8 + 2, sizeof(uint32_t));
+    uint64_t* taken = malloc(sizeof(uint64_t) * ((uint64_t) count / 64 + 1));
+    uint32_t* placed = malloc(sizeof(uint32_t) * ((uint64_t) count + 1));
+    int allocated = hashes != NULL && bucketStart != NULL && bucketKeys != NULL && bucketOrder != NULL
+                    && sizeStart != NULL && taken != NULL && placed != NULL;
+    int success = 0;
+    int duplicate = 0;
+    uint64_t seed;
+    uint64_t maxDisplacement = (uint64_t) count * WORLD_NAME_DISPLACEMENTS_PER_SLOT + 256;
+    if (maxDisplacement > WORLD_NAME_MAX_DISPLACEMENT) {
+        maxDisplacement = WORLD_NAME_MAX_DISPLACEMENT;
+    }
+
+    // Try seeds until every bucket could be placed
+    for (seed = 0; seed < WORLD_NAME_MAX_SEEDS && success == 0 && duplicate == 0 && allocated == 1; seed++) {
+        uint32_t i;
+        uint32_t largest = 0;
+
+        index->seed = worldMix64(seed + 1);
+        index->bucketCount = bucketCount;
+        index->slotCount = count;
+        memset(bucketStart, 0, sizeof(uint32_t) * ((uint64_t) bucketCount + 1));
+        memset(taken, 0, sizeof(uint64_t) * ((uint64_t) count / 64 + 1));
+
+        // Hash names and count bucket sizes
+        for (i = 0; i < count; i++) {
+            hashes[i] = worldHashName(names[i], index->seed);
+            bucketStart[worldReduce(hashes[i], bucketCount) + 1]++;
+        }
+        for (i = 0; i < bucketCount; i++) {
+            if (bucketStart[i + 1] > largest) {
+                largest = bucketStart[i + 1];
+            }
+            bucketStart[i + 1] += bucketStart[i];
+        }
+        // Buckets far larger than expected mean a bad seed
+        if (largest > WORLD_NAME_BUCKET_SIZE * 8) {
+            continue;
+        }
+
+        // Group names by bucket, using placed as the fill position of each bucket
+        memcpy(placed, bucketStart, sizeof(uint32_t) * bucketCount);
+        for (i = 0; i < count; i++) {
+            bucketKeys[placed[worldReduce(hashes[i], bucketCount)]++] = i;
+        }
+
+        // Equal hashes share a bucket and land on the same slot for every displacement
+        int collision = 0;
+        for (i = 0; i < count && duplicate == 0; i++) {
+            uint32_t bucket = worldReduce(hashes[bucketKeys[i]], bucketCount);
+            uint32_t other;
+            for (other = i + 1; other < bucketStart[bucket + 1]; other++) {
+                if (hashes[bucketKeys[other]] == hashes[bucketKeys[i]]) {
+                    collision = 1;
+                    duplicate = strcmp(names[bucketKeys[other]], names[bucketKeys[i]]) == 0;
+                    break;
+                }
+            }
+        }
+        if (collision == 1) {
+            continue;
+        }
+
+        // Order buckets largest first with a counting sort on size
+        memset(sizeStart, 0, sizeof(uint32_t) * (WORLD_NAME_BUCKET_SIZE * 8 + 2));
+        for (i = 0; i < bucketCount; i++) {
+            sizeStart[largest - (bucketStart[i + 1] - bucketStart[i]) + 1]++;
+        }
+        for (i = 0; i < largest + 1; i++) {
+            sizeStart[i + 1] += sizeStart[i];
+        }
+        for (i = 0; i < bucketCount; i++) {
+            bucketOrder[sizeStart[largest - (bucketStart[i + 1] - bucketStart[i])]++] = i;
+        }
+
+        success = 1;
+        // Place each bucket on free slots
+        for (i = 0; i < bucketCount && success == 1; i++) {
+            uint32_t bucket = bucketOrder[i];
+            uint32_t first = bucketStart[bucket];
+            uint32_t size = bucketStart[bucket + 1] - first;
+            uint32_t displacement;
+
+            displacements[bucket] = 0;
+            if (size == 0) {
+                continue;
+            }
+
+            success = 0;
+            for (displacement = 0; displacement < maxDisplacement && success == 0; displacement++) {
+                uint32_t key;
+                success = 1;
+
+                // Claim a slot per name, undoing the claims if one collides
+                for (key = 0; key < size; key++) {
+                    uint32_t slot = worldNameSlot(hashes[bucketKeys[first + key]], displacement, count);
+                    if ((taken[slot / 64] >> (slot % 64)) & 1) {
+                        uint32_t undo;
+                        for (undo = 0; undo < key; undo++) {
+                            taken[placed[undo] / 64] &= ~(1ULL << (placed[undo] % 64));
+                        }
+                        success = 0;
+                        break;
+                    }
+                    taken[slot / 64] |= 1ULL << (slot % 64);
+                    placed[key] = slot;
+                }
+
+                if (success == 1) {
+                    displacements[bucket] = displacement;
+                    for (key = 0; key < size; key++) {
+                        slots[placed[key]] = bucketKeys[first + key];
+                    }
+                }
+            }
+        }
+    }
+
+    free(hashes);
+    free(bucketStart);
+    free(bucketKeys);
+    free(bucketOrder);
+    free(sizeStart);
+    free(taken);
+    free(placed);
+
+    return success;
+}
+
+// Number of rooms covered by the next hop matrix of a world: all of them for worlds up to WORLD_ROUTE_MATRIX_LIMIT
+// rooms, otherwise none.
+// Pre-conditions: Pass number of rooms.
+// Post-conditions: Returns matrix rooms.
+static inline uint32_t worldRouteMatrixRooms(uint32_t roomCount) {
+    return roomCount <= WORLD_ROUTE_MATRIX_LIMIT ? roomCount : 0;
+}
+
+// Size in bytes of a routes section.
+// Pre-conditions: Pass number of rooms and number of rooms covered by the matrix.
+// Post-conditions: Returns section size.
+static inline uint64_t worldRoutesSize(uint32_t roomCount, uint32_t matrixRooms) {
+    return sizeof(struct packedRoutes) + sizeof(uint32_t) * 2 * (uint64_t) roomCount
+           + (uint64_t) matrixRooms * matrixRooms;
+}
+
+// Breadth first search towards one target room over reversed connections. Every room that can reach the target
+// gets its distance and the room it moves to first, so the search answers "which way to target" for all rooms.
+// Pre-conditions: Pass reversed adjacency (the rooms connecting to room r are reverseRooms[reverseStart[r]] up to
+// reverseRooms[reverseStart[r + 1]]), number of rooms, target room and arrays of roomCount entries to fill.
+// Post-conditions: distances and nextHops are set, WORLD_ROUTE_NONE for rooms that can't reach the target.
+static inline void worldSearchRoutes(const uint32_t* reverseStart, const uint32_t* reverseRooms, uint32_t roomCount,
+                                     uint32_t target, uint32_t* distances, uint32_t* nextHops, uint32_t* queue) {
+    uint32_t queueHead = 0;
+    uint32_t queueTail = 0;
+    uint32_t room;
+
+    for (room = 0; room < roomCount; room++) {
+        distances[room] = WORLD_ROUTE_NONE;
+        nextHops[room] = WORLD_ROUTE_NONE;
+    }
+    distances[target] = 0;
+    queue[queueTail++] = target;
+
+    while (queueHead < queueTail) {
+        room = queue[queueHead++];
+
+        uint32_t edge;
+        for (edge = reverseStart[room]; edge < reverseStart[room + 1]; edge++) {
+            uint32_t from = reverseRooms[edge];
+            if (distances[from] == WORLD_ROUTE_NONE) {
+                distances[from] = distances[room] + 1;
+                nextHops[from] = room;
+                queue[queueTail++] = from;
+            }
+        }
+    }
+}
+
+// Fills the next hop matrix with a breadth first search towards every room at once. Each room keeps a bit set of
+// the rooms it can reach, and every round a room adds the sets its connections had after the previous round. Bits
+// that are new to a room were first reached through that connection, one step further away than from the
+// connection, so the connection's index is the room's next hop towards them. A round costs a few word operations
+// per connection and there are as many rounds as the longest shortest path, instead of one search per room.
+// Pre-conditions: Pass room records, adjacency array, number of rooms of at most WORLD_ROUTE_MATRIX_LIMIT and matrix
+// of roomCount by roomCount bytes.
+// Post-conditions: Fills the matrix and returns 1, or returns 0 if its bit sets could not be allocated.
+static inline int worldBuildRouteMatrix(const struct packedRoom* rooms, const uint32_t* connections,
+                                        uint32_t roomCount, uint8_t* matrix) {
+    uint32_t words = (roomCount + 63) / 64;
+    uint64_t* reached = calloc((uint64_t) roomCount * words, sizeof(uint64_t));
+    uint64_t* previous = malloc(sizeof(uint64_t) * (uint64_t) roomCount * words);
+    if (reached == NULL || previous == NULL) {
+        free(reached);
+        free(previous);
+        return 0;
+    }
+
+    memset(matrix, WORLD_ROUTE_MATRIX_NONE, (uint64_t) roomCount * roomCount);
+    uint32_t room;
+    for (room = 0; room < roomCount; room++) {
+        reached[(uint64_t) room * words + room / 64] = 1ULL << (room % 64);
+    }
+
+    int changed = 1;
+    // Grow every room's reached set by one step per round until no set changes
+    while (changed == 1) {
+        changed = 0;
+        memcpy(previous, reached, sizeof(uint64_t) * (uint64_t) roomCount * words);
+
+        for (room = 0; room < roomCount; room++) {
+            uint64_t* roomReached = &reached[(uint64_t) room * words];
+            uint32_t conn;
+
+            for (conn = 0; conn < rooms[room].connectionCount; conn++) {
+                uint32_t connRoom = connections[rooms[room].firstConnection + conn];
+                const uint64_t* connReached = &previous[(uint64_t) connRoom * words];
+                uint32_t word;
+
+                for (word = 0; word < words; word++) {
+                    uint64_t fresh = connReached[word] & ~roomReached[word];
+                    roomReached[word] |= fresh;
+
+                    // Record this connection as the next hop towards every newly reached room
+                    while (fresh != 0) {
+                        matrix[(uint64_t) room * roomCount + word * 64 + __builtin_ctzll(fresh)] = (uint8_t) conn;
+                        fresh &= fresh - 1;
+                        changed = 1;
+                    }
+                }
+            }
+        }
+    }
+
+    free(reached);
+    free(previous);
+
+    return 1;
+}
+
+// Builds the routes section of a world. A search towards the end room fills the linear tables, and worlds small
+// enough to have a matrix also get worldBuildRouteMatrix. Connections are searched in reverse, so the tables are
+// also right for worlds whose connections only go one way.
+// Pre-conditions: Pass room records, adjacency array, number of rooms, end room and output buffer of
+// worldRoutesSize(roomCount, worldRouteMatrixRooms(roomCount)) bytes.
+// Post-conditions: Fills the routes section and returns 1, or returns 0 if its work arrays could not be allocated.
+static inline int worldBuildRoutes(const struct packedRoom* rooms, const uint32_t* connections, uint32_t roomCount,
+                                   uint32_t endRoom, void* out) {
+    struct packedRoutes* routes = out;
+    uint32_t* endDistances = (uint32_t*) (routes + 1);
+    uint32_t* endNextHops = endDistances + roomCount;
+
+    uint64_t connectionCount = 0;
+    uint32_t room;
+    for (room = 0; room < roomCount; room++) {
+        connectionCount += rooms[room].connectionCount;
+    }
+
+    uint32_t* reverseStart = calloc((uint64_t) roomCount + 1, sizeof(uint32_t));
+    uint32_t* reverseRooms = malloc(sizeof(uint32_t) * (connectionCount + 1));
+    uint32_t* queue = malloc(sizeof(uint32_t) * (uint64_t) roomCount);
+    int success = reverseStart != NULL && reverseRooms != NULL && queue != NULL;
+
+    if (success == 1) {
+        uint32_t conn;
+        // Count connections into every room, then place them with a counting sort
+        for (room = 0; room < roomCount; room++) {
+            for (conn = 0; conn < rooms[room].connectionCount; conn++) {
+                reverseStart[connections[rooms[room].firstConnection + conn] + 1]++;
+            }
+        }
+        for (room = 0; room < roomCount; room++) {
+            reverseStart[room + 1] += reverseStart[room];
+        }
+        memcpy(queue, reverseStart, sizeof(uint32_t) * (uint64_t) roomCount);
+        for (room = 0; room < roomCount; room++) {
+            for (conn = 0; conn < rooms[room].connectionCount; conn++) {
+                reverseRooms[queue[connections[rooms[room].firstConnection + conn]]++] = room;
+            }
+        }
+
+        routes->endRoom = endRoom;
+        routes->matrixRooms = worldRouteMatrixRooms(roomCount);
+        worldSearchRoutes(reverseStart, reverseRooms, roomCount, endRoom, endDistances, endNextHops, queue);
+        if (routes->matrixRooms != 0) {
+            success = worldBuildRouteMatrix(rooms, connections, roomCount, (uint8_t*) (endNextHops + roomCount));
+        }
+    }
+
+    free(reverseStart);
+    free(reverseRooms);
+    free(queue);
+
+    return success;
+}
+
+// Adds a section to a packed world header.
+// Pre-conditions: Pass header with room for another section, section id, offset and size.
+// Post-conditions: Section is listed in the header.
+static inline void worldAddSection(struct packedHeader* header, uint32_t id, uint64_t offset, uint64_t size) {
+    header->sections[header->sectionCount].id = id;
+    header->sections[header->sectionCount].offset = offset;
+    header->sections[header->sectionCount].size = size;
+    header->sectionCount++;
+}
+
+// Lays out a new packed world in one zeroed buffer: header, STRINGS, ROOMS and ADJACENCY sections, room for the
+// name index and routes that worldFinish builds right after the adjacency array, and a SOURCE section at the end
+// if sourceSize is not 0. The caller fills the
+// string table, room records and adjacency array (found with worldFindSection) and then calls worldFinish.
+// Pre-conditions: Pass number of rooms and connections, size of the string table including terminators, size of
+// the source section or 0 and pointer to hold the file size.
+// Post-conditions: Returns buffer of fileSize bytes with the header filled in. Exits if it can't be allocated.
+static inline char* worldCreate(uint32_t roomCount, uint64_t connectionCount, uint64_t stringsSize,
+                                uint64_t sourceSize, uint64_t* fileSize) {
+    uint64_t stringsOffset = worldAlign(sizeof(struct packedHeader));
+    uint64_t roomsOffset = stringsOffset + worldAlign(stringsSize);
+    uint64_t adjacencyOffset = roomsOffset + worldAlign(sizeof(struct packedRoom) * (uint64_t) roomCount);
+    uint64_t nameIndexOffset = adjacencyOffset + worldAlign(sizeof(uint32_t) * connectionCount);
+    uint64_t routesOffset = nameIndexOffset + worldAlign(worldNameIndexSize(roomCount));
+    uint64_t sourceOffset = routesOffset + worldAlign(worldRoutesSize(roomCount, worldRouteMatrixRooms(roomCount)));
+    *fileSize = sourceOffset + worldAlign(sourceSize);
+
+    char* buffer = calloc(1, *fileSize);
+    if (buffer == NULL) {
+        perror("Error allocating packed world");
+        exit(1);
+    }
+
+    struct packedHeader* header = (struct packedHeader*) buffer;
+    memcpy(header->magic, WORLD_MAGIC, 8);
+    header->version = WORLD_VERSION;
+    header->roomCount = roomCount;
+    header->connectionCount = (uint32_t) connectionCount;
+    header->fileSize = *fileSize;
+    worldAddSection(header, WORLD_SECTION_STRINGS, stringsOffset, stringsSize);
+    worldAddSection(header, WORLD_SECTION_ROOMS, roomsOffset, sizeof(struct packedRoom) * (uint64_t) roomCount);
+    worldAddSection(header, WORLD_SECTION_ADJACENCY, adjacencyOffset, sizeof(uint32_t) * connectionCount);
+    if (sourceSize > 0) {
+        worldAddSection(header, WORLD_SECTION_SOURCE, sourceOffset, sourceSize);
+    }
+
+    return buffer;
+}
+
+// Finishes a packed world laid out by worldCreate once its rooms are filled in: finds the start and end rooms from
+// the room types, then builds the name index and routes. Readers build their own index and routes for worlds
+// without them, so a failed build only drops that section.
+// Pre-conditions: Pass buffer from worldCreate with strings, room records and adjacency filled in.
+// Post-conditions: Returns 1 if the world is complete, or 0 if it has no start or no end room.
+static inline int worldFinish(char* buffer) {
+    struct packedHeader* header = (struct packedHeader*) buffer;
+    const struct packedSection* adjacency = worldFindSection(header, WORLD_SECTION_ADJACENCY);
+    uint64_t nameIndexOffset = adjacency->offset + worldAlign(adjacency->size);
+    uint64_t routesOffset = nameIndexOffset + worldAlign(worldNameIndexSize(header->roomCount));
+
+    const char* strings = buffer + worldFindSection(header, WORLD_SECTION_STRINGS)->offset;
+    const struct packedRoom* rooms =
+            (const struct packedRoom*) (buffer + worldFindSection(header, WORLD_SECTION_ROOMS)->offset);
+    const uint32_t* connections = (const uint32_t*) (buffer + adjacency->offset);
+
+    const char** names = malloc(sizeof(char*) * ((uint64_t) header->roomCount + 1));
+    if (names == NULL) {
+        perror("Error allocating packed world");
+        exit(1);
+    }
+
+    int startRoom = -1;
+    int endRoom = -1;
+    uint32_t room;
+    for (room = 0; room < header->roomCount; room++) {
+        names[room] = &strings[rooms[room].nameOffset];
+        if (rooms[room].type == ROOM_TYPE_START) {
+            startRoom = (int) room;
+        }
+        else if (rooms[room].type == ROOM_TYPE_END) {
+            endRoom = (int) room;
+        }
+    }
+
+    if (startRoom == -1 || endRoom == -1) {
+        free(names);
+        return 0;
+    }
+    header->startRoom = (uint32_t) startRoom;
+    header->endRoom = (uint32_t) endRoom;
+
+    if (worldBuildNameIndex(names, header->roomCount, buffer + nameIndexOffset) == 1) {
+        worldAddSection(header, WORLD_SECTION_NAME_INDEX, nameIndexOffset, worldNameIndexSize(header->roomCount));
+    }
+    if (worldBuildRoutes(rooms, connections, header->roomCount, header->endRoom, buffer + routesOffset) == 1) {
+        worldAddSection(header, WORLD_SECTION_ROUTES, routesOffset,
+                        worldRoutesSize(header->roomCount, worldRouteMatrixRooms(header->roomCount)));
+    }
+    free(names);
+
+    return 1;
+}
+
+// Writes a finished packed world to a file with a single open, write and close, continuing after partial writes.
+// Pre-conditions: Pass name of file to create, buffer and its size.
+// Post-conditions: Returns 1 if the whole file was written, otherwise 0 with errno set.
+static inline int worldWriteFile(const char* fileName, const char* buffer, uint64_t size) {
+    int fileFd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fileFd < 0) {
+        return 0;
+    }
+
+    while (size > 0) {
+        ssize_t written = write(fileFd, buffer, size);
+        if (written <= 0) {
+            close(fileFd);
+            return 0;
+        }
+        buffer += written;
+        size -= (uint64_t) written;
+    }
+
+    return close(fileFd) == 0;
+}
+
+// Checks the parts of a packed world that the header alone describes: magic and version match, every section lies
+// inside the file, and the required sections are present and large enough for the counts in the header. This is
+// all a loader that reads rooms on demand can check up front, so it only reads the header.
+// Pre-conditions: Pass header read from the start of the file and the file size.
+// Post-conditions: Returns 1 if the layout is valid, otherwise 0.
+static inline int worldValidateLayout(const struct packedHeader* header, uint64_t size) {
+    if (size < sizeof(struct packedHeader) || memcmp(header->magic, WORLD_MAGIC, 8) != 0
+        || header->version != WORLD_VERSION || header->sectionCount > WORLD_MAX_SECTIONS
+        || header->fileSize != size || header->roomCount < 2 || header->startRoom >= header->roomCount
+        || header->endRoom >= header->roomCount) {
+        return 0;
+    }
+
+    uint32_t i;
+    // Every section must be aligned and inside the file
+    for (i = 0; i < header->sectionCount; i++) {
+        const struct packedSection* section = &header->sections[i];
+        if (section->offset % 8 != 0 || section->offset > size || section->size > size - section->offset) {
+            return 0;
+        }
+    }
+
+    const struct packedSection* strings = worldFindSection(header, WORLD_SECTION_STRINGS);
+    const struct packedSection* rooms = worldFindSection(header, WORLD_SECTION_ROOMS);
+    const struct packedSection* adjacency = worldFindSection(header, WORLD_SECTION_ADJACENCY);
+    if (strings == NULL || rooms == NULL || adjacency == NULL
+        || rooms->size < (uint64_t) header->roomCount * sizeof(struct packedRoom)
+        || adjacency->size < (uint64_t) header->connectionCount * sizeof(uint32_t)) {
+        return 0;
+    }
+
+    const struct packedSection* source = worldFindSection(header, WORLD_SECTION_SOURCE);
+    if (source != NULL && source->size < sizeof(struct packedSource)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+// Checks that a room record's name and connections lie inside their sections. The name's terminator and the
+// connected room ids are in other sections, so callers check those once they have read them.
+// Pre-conditions: Pass header with a valid layout and the room record.
+// Post-conditions: Returns 1 if the record is valid, otherwise 0.
+static inline int worldValidateRoom(const struct packedHeader* header, const struct packedRoom* room) {
+    return (uint64_t) room->nameOffset + room->nameLength < worldFindSection(header, WORLD_SECTION_STRINGS)->size
+           && (uint64_t) room->firstConnection + room->connectionCount <= header->connectionCount
+           && room->type <= ROOM_TYPE_END;
+}
+
+// Checks that a name index section covers every room of the world and is large enough for its arrays.
+// Pre-conditions: Pass header with a valid layout, the name index section and the index header read from it.
+// Post-conditions: Returns 1 if the index header is valid, otherwise 0.
+static inline int worldValidateNameIndex(const struct packedHeader* header, const struct packedSection* section,
+                                         const struct packedNameIndex* index) {
+    return section->size >= sizeof(struct packedNameIndex) && index->slotCount == header->roomCount
+           && index->bucketCount == header->roomCount / WORLD_NAME_BUCKET_SIZE + 1
+           && section->size >= worldNameIndexSize(header->roomCount);
+}
+
+// Checks that a routes section leads to the world's end room and is large enough for its tables.
+// Pre-conditions: Pass header with a valid layout, the routes section and the routes header read from it.
+// Post-conditions: Returns 1 if the routes header is valid, otherwise 0.
+static inline int worldValidateRoutes(const struct packedHeader* header, const struct packedSection* section,
+                                      const struct packedRoutes* routes) {
+    return section->size >= sizeof(struct packedRoutes) && routes->endRoom == header->endRoom
+           && (routes->matrixRooms == 0 || routes->matrixRooms == header->roomCount)
+           && section->size >= worldRoutesSize(header->roomCount, routes->matrixRooms);
+}
+
+// Checks that a buffer holds a well formed packed world: the layout is valid (see worldValidateLayout), every
+// room's name and connections point inside their sections, and the optional sections only hold valid room ids.
+// Loaders call this once so the rest of the program can trust the file.
+// Pre-conditions: Pass buffer with the whole file and its size.
+// Post-conditions: Returns 1 if the world is valid, otherwise 0.
+static inline int worldValidate(const void* data, uint64_t size) {
+    const struct packedHeader* header = data;
+    if (size < sizeof(struct packedHeader) || worldValidateLayout(header, size) == 0) {
+        return 0;
+    }
+
+    const struct packedSection* strings = worldFindSection(header, WORLD_SECTION_STRINGS);
+    const char* stringData = (const char*) data + strings->offset;
+    const struct packedRoom* roomData =
+            (const struct packedRoom*) ((const char*) data + worldFindSection(header, WORLD_SECTION_ROOMS)->offset);
+    const uint32_t* connections =
+            (const uint32_t*) ((const char*) data + worldFindSection(header, WORLD_SECTION_ADJACENCY)->offset);
+    uint32_t i;
+    // Every room must have a terminated name and connections to existing rooms
+    for (i = 0; i < header->roomCount; i++) {
+        const struct packedRoom* room = &roomData[i];
+        if (worldValidateRoom(header, room) == 0 || stringData[room->nameOffset + room->nameLength] != '\0') {
+            return 0;
+        }
+
+        uint32_t conn;
+        for (conn = 0; conn < room->connectionCount; conn++) {
+            if (connections[room->firstConnection + conn] >= header->roomCount) {
+                return 0;
+            }
+        }
+    }
+
+    const struct packedSection* nameIndex = worldFindSection(header, WORLD_SECTION_NAME_INDEX);
+    // Name index is optional, but must cover every room when present
+    if (nameIndex != NULL) {
+        const struct packedNameIndex* index = (const struct packedNameIndex*) ((const char*) data + nameIndex->offset);
+        if (nameIndex->size < sizeof(struct packedNameIndex) || worldValidateNameIndex(header, nameIndex, index) == 0) {
+            return 0;
+        }
+
+        const uint32_t* slots = (const uint32_t*) (index + 1) + index->bucketCount;
+        for (i = 0; i < index->slotCount; i++) {
+            if (slots[i] >= header->roomCount) {
+                return 0;
+            }
+        }
+    }
+
+    const struct packedSection* routeSection = worldFindSection(header, WORLD_SECTION_ROUTES);
+    // Routes are optional, but every next hop must be a connection of its room when present
+    if (routeSection != NULL) {
+        const struct packedRoutes* routes = (const struct packedRoutes*) ((const char*) data + routeSection->offset);
+        if (routeSection->size < sizeof(struct packedRoutes)
+            || worldValidateRoutes(header, routeSection, routes) == 0) {
+            return 0;
+        }
+
+        const uint32_t* endNextHops = (const uint32_t*) (routes + 1) + header->roomCount;
+        const uint8_t* matrix = (const uint8_t*) (endNextHops + header->roomCount);
+        for (i = 0; i < header->roomCount; i++) {
+            const struct packedRoom* room = &roomData[i];
+            uint32_t conn;
+
+            if (endNextHops[i] != WORLD_ROUTE_NONE) {
+                for (conn = 0; conn < room->connectionCount; conn++) {
+                    if (connections[room->firstConnection + conn] == endNextHops[i]) {
+                        break;
+                    }
+                }
+                if (conn == room->connectionCount) {
+                    return 0;
+                }
+            }
+
+            uint32_t target;
+            for (target = 0; target < routes->matrixRooms; target++) {
+                uint8_t entry = matrix[(uint64_t) i * routes->matrixRooms + target];
+                if (entry != WORLD_ROUTE_MATRIX_NONE && entry >= room->connectionCount) {
+                    return 0;
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+#endif